@@ -297,10 +297,9 @@ static void population_tick(void)
 		if(b->last_time > 10){
 			run_network_on_bird(b, i);
 		}
-
-		neat_increase_time_alive(neat, i);
 	}
 
+	neat_tick(neat);
 	neat_epoch(neat, NULL);
 }
 
@@ -60,10 +60,9 @@ static gboolean tick(gpointer data)
 			best = i;
 		}
 		neat_set_fitness(neat, i, fitness);
-
-		neat_increase_time_alive(neat, i);
 	}
 
+	neat_tick(neat);
 	neat_epoch(neat, &worst);
 
 	frame++;
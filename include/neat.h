@@ -6,6 +6,11 @@
 #include <nn.h>
 
 typedef void* neat_t;
+/* Read-only view on a population saved with neat_save_snapshot */
+typedef void* neat_snapshot_t;
+
+/* Species handle of a genome that's not in a species */
+#define NEAT_SPECIES_HANDLE_NONE ((uint64_t)0xFFFFFFFFFFFFFFFFUL)
 
 struct neat_config{
 	/* Neural Networks */
@@ -37,6 +42,27 @@ struct neat_config{
 	
 	enum nn_activation genome_default_hidden_activation;
 	enum nn_activation genome_default_output_activation;
+
+	/* Random */
+	/* Seed for the random number generator of the population, the same
+	 * seed gives the same results, 0 picks one based on the time
+	 */
+	unsigned long seed;
+
+	/* Evaluation */
+	/* Amount of fitnesses remembered for genomes with the same network, see
+	 * neat_get_memoized_fitness, 0 disables it
+	 */
+	size_t fitness_memo_size;
+
+	/* Generations */
+	/* Part of the population that's replaced by neat_epoch_generation */
+	float generation_replacement_fraction;
+	/* Amount of threads used to mutate the offspring of a generation and
+	 * to respeciate the genomes, 0 or 1 does everything on the calling
+	 * thread
+	 */
+	size_t threads;
 };
 
 struct neat_config neat_get_default_config(void);
@@ -46,13 +72,28 @@ neat_t neat_create(struct neat_config config);
 /* Destroy the population, this frees all the memory allocated by it */
 void neat_destroy(neat_t population);
 
+/* Save the complete state of the population, loading it continues the run
+ * exactly where it was saved, remembered fitnesses are not saved
+ * compress	store genomes as the differences with their species
+ *		representant
+ *
+ * return false if writing to the file failed
+ */
+bool neat_save(neat_t population, FILE *file, bool compress);
+/* Load a population saved with neat_save, the file is read until the end
+ *
+ * return NULL if the data is invalid
+ */
+neat_t neat_load(FILE *file);
+
 /* Run the neural network
  * genome_id	id of the genome where the network resides
  * inputs	array of floats to use as the inputs, the amount is defined by
  * 		the "network_inputs" field in the config
  *
  * return an array of outputs as run through the network. the amount is defined
- * by the "network_outputs" field in the config
+ * by the "network_outputs" field in the config, it's valid until the genome is
+ * run again or replaced
  */
 const float *neat_run(neat_t population, size_t genome_id, const float *inputs);
 
@@ -63,11 +104,61 @@ const float *neat_run(neat_t population, size_t genome_id, const float *inputs);
  */
 void neat_set_fitness(neat_t population, size_t genome_id, float fitness);
 
-/* Increase the time a genome is alive, should be used every tick
+/* Increase the time all the genomes are alive, should be used every tick
+ */
+void neat_tick(neat_t population);
+/* Increase the time a single genome is alive, this can be used instead of
+ * neat_tick to age the genomes separately
  * genome_id	id of the genome to increase the time alive of
  */
 void neat_increase_time_alive(neat_t population, size_t genome_id);
 
+/* Get the fitness of a genome with exactly the same network that was set
+ * before with neat_set_fitness, this can be used to skip the evaluation of
+ * clones when the task is deterministic, it needs a "fitness_memo_size" in the
+ * config
+ * fitness	pointer where the remembered fitness is written to
+ *
+ * return true if the fitness was found
+ */
+bool neat_get_memoized_fitness(neat_t population,
+			       size_t genome_id,
+			       float *fitness);
+
+/* Thread evaluating genomes for neat_evaluate_parallel */
+struct neat_worker;
+
+/* Calculate the fitness of a genome, it's called from multiple threads at the
+ * same time so everything besides the worker must be thread safe
+ * worker	run the genome with neat_worker_run
+ * user_data	pointer passed to neat_evaluate_parallel
+ */
+typedef float (*neat_fitness_func)(struct neat_worker *worker,
+				   size_t genome_id,
+				   void *user_data);
+
+/* Run the network of the genome that's evaluated by the worker
+ *
+ * return the outputs, they're valid until the next call with the same worker
+ */
+const float *neat_worker_run(struct neat_worker *worker, const float *inputs);
+/* Random number generator for the evaluation, it's derived from the genome id
+ * so the results don't depend on the thread that evaluates it
+ */
+struct nn_rng *neat_worker_get_rng(struct neat_worker *worker);
+
+/* Evaluate all the genomes over multiple threads and set their fitness,
+ * threads that finish early take over work of the others so fitness functions
+ * that take more time for some genomes still keep all the threads busy, the
+ * time alive is not increased
+ * threads	amount of threads to use, 0 or 1 evaluates everything on the
+ *		calling thread
+ */
+void neat_evaluate_parallel(neat_t population,
+			    neat_fitness_func fitness,
+			    void *user_data,
+			    size_t threads);
+
 /* Update the whole population, this will check if any genomes died and
  * reproduces them if so
  * worst_genome	pointer to the genome that will be replaced, NULL if nothing is
@@ -76,9 +167,86 @@ void neat_increase_time_alive(neat_t population, size_t genome_id);
  * return a boolean determining if a genome got replaced
  */
 bool neat_epoch(neat_t population, size_t *worst_genome);
+/* Replace a whole part of the population at once instead of a single genome,
+ * the "generation_replacement_fraction" in the config decides how many, the
+ * weakest genomes that lived long enough are replaced and the species get
+ * offspring in proportion to their average fitness, this can be used instead
+ * of neat_epoch to evolve big populations in fewer steps
+ * replaced	array with room for population_size ids where the ids of the
+ *		replaced genomes are written to, can be NULL
+ *
+ * return the amount of genomes that got replaced
+ */
+size_t neat_epoch_generation(neat_t population, size_t *replaced);
 
 const struct nn_ffnet *neat_get_network(neat_t population, size_t genome_id);
+
+/* Statistics about the structure of a genome, the layer arrays contain
+ * nhidden_layers + 1 counts where the last one is the output layer, the
+ * weights of a layer are the ones going into it, they're only valid until the
+ * next call to neat_epoch
+ */
+struct neat_genome_info{
+	size_t nweights, nactivations, nhidden_layers;
+	/* Weights that aren't 0 and activations that aren't passthrough */
+	size_t used_weights, used_activations;
+	const size_t *layer_weights, *layer_activations;
+};
+
+void neat_get_genome_info(neat_t population,
+			  size_t genome_id,
+			  struct neat_genome_info *info);
+/* Hash of the shape, the weights and the activations of the network, genomes
+ * with the same network have the same fingerprint
+ */
+uint64_t neat_get_fingerprint(neat_t population, size_t genome_id);
+
+/* Encode the genome in a compact binary form, for example to write it to a log
+ * or to send it to another process
+ * buffer	where the data is written to, nothing is written past size
+ *
+ * return the size of the encoded genome, when it's bigger than size the buffer
+ * was too small and should be enlarged
+ */
+size_t neat_encode_genome(neat_t population,
+			  size_t genome_id,
+			  void *buffer,
+			  size_t size);
+/* Encode only the differences of the genome with its parent, this is a lot
+ * smaller for offspring that only got a few mutations, it falls back to the
+ * full encoding if the parent has a different shape
+ * parent_id	id of the parent genome, the population decoding it needs a
+ *		genome with exactly the same network
+ */
+size_t neat_encode_genome_delta(neat_t population,
+				size_t genome_id,
+				size_t parent_id,
+				void *buffer,
+				size_t size);
+/* Replace a genome with an encoded one, a delta is applied to the genome in the
+ * population with the fingerprint of the parent
+ * genome_id	id of the genome to replace, it starts with no fitness
+ *
+ * return false if the data is invalid or the parent isn't in the population,
+ * the genome isn't replaced then
+ */
+bool neat_decode_genome(neat_t population,
+			size_t genome_id,
+			const void *data,
+			size_t size);
 size_t neat_get_species_id(neat_t population, size_t genome_id);
+/* Handle of the species of the genome, unlike the id it doesn't change when
+ * other species are removed and it's never given to another species so it can
+ * be stored
+ *
+ * return NEAT_SPECIES_HANDLE_NONE if the genome is not in a species
+ */
+uint64_t neat_get_species_handle(neat_t population, size_t genome_id);
+/* Look up the current id of the species
+ *
+ * return SIZE_MAX if the species doesn't exist anymore
+ */
+size_t neat_get_species_id_of_handle(neat_t population, uint64_t handle);
 
 size_t neat_get_num_species(neat_t population);
 size_t neat_get_num_genomes_in_species(neat_t population, size_t species_id);
@@ -86,3 +254,68 @@ float neat_get_average_fitness_of_species(neat_t population, size_t species_id);
 bool neat_get_species_is_alive(neat_t population, size_t species_id);
 
 void neat_print_net(neat_t population, size_t genome_id);
+
+/* Save the population as a snapshot, the genomes and the networks refer to
+ * each other with offsets instead of pointers so it can be used in place
+ * without loading it, it's only readable on machines with the same byte order
+ *
+ * return false if writing to the file failed
+ */
+bool neat_save_snapshot(neat_t population, FILE *file);
+/* Use a snapshot that's in memory, only the tables are checked so opening is
+ * fast and the networks are only read when they're used
+ * data		the snapshot, aligned to 8 bytes, it's not copied so it must
+ *		stay valid until the snapshot is closed
+ *
+ * return NULL if the data isn't a valid snapshot
+ */
+neat_snapshot_t neat_snapshot_open(const void *data, size_t size);
+/* Map the snapshot file in memory read-only and open it
+ *
+ * return NULL if the file can't be mapped or isn't a valid snapshot
+ */
+neat_snapshot_t neat_snapshot_map(const char *path);
+/* Close the snapshot, it's unmapped if it was opened with neat_snapshot_map */
+void neat_snapshot_close(neat_snapshot_t snapshot);
+
+/* Run the network of a genome in the snapshot
+ *
+ * return the outputs, they're valid until the next call with the same
+ * snapshot, NULL if the network in the snapshot is invalid
+ */
+const float *neat_run_snapshot(neat_snapshot_t snapshot,
+			       size_t genome_id,
+			       const float *inputs);
+/* Get the network of a genome in the snapshot, its memory is the data of the
+ * snapshot so it's valid until the next call with the same snapshot and must
+ * not be changed
+ *
+ * return NULL if the network in the snapshot is invalid
+ */
+const struct nn_ffnet *neat_snapshot_get_network(neat_snapshot_t snapshot,
+						 size_t genome_id);
+
+size_t neat_snapshot_get_num_genomes(neat_snapshot_t snapshot);
+/* The last fitness that was set for the genome before saving */
+float neat_snapshot_get_fitness(neat_snapshot_t snapshot, size_t genome_id);
+/* The amount of ticks the genome was alive when it was saved */
+size_t neat_snapshot_get_age(neat_snapshot_t snapshot, size_t genome_id);
+uint64_t neat_snapshot_get_fingerprint(neat_snapshot_t snapshot,
+				       size_t genome_id);
+/* return SIZE_MAX if the genome is not in a species */
+size_t neat_snapshot_get_species_id(neat_snapshot_t snapshot,
+				    size_t genome_id);
+
+size_t neat_snapshot_get_num_species(neat_snapshot_t snapshot);
+size_t neat_snapshot_get_num_genomes_in_species(neat_snapshot_t snapshot,
+						size_t species_id);
+/* Id of the member of the species at the index, the first one is the
+ * representant
+ */
+size_t neat_snapshot_get_genome_in_species(neat_snapshot_t snapshot,
+					   size_t species_id,
+					   size_t index);
+float neat_snapshot_get_average_fitness_of_species(neat_snapshot_t snapshot,
+						   size_t species_id);
+bool neat_snapshot_get_species_is_alive(neat_snapshot_t snapshot,
+					size_t species_id);
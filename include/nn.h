@@ -2,6 +2,7 @@
 
 #include <stdlib.h>
 #include <stdbool.h>
+#include <stdint.h>
 
 enum nn_activation{
 	NN_ACTIVATION_PASSTHROUGH = 0,
@@ -12,6 +13,56 @@ enum nn_activation{
 	_NN_ACTIVATION_COUNT
 };
 
+/* Random number generator (xoshiro128**), every instance has its own state so
+ * there is no global state shared between threads
+ */
+struct nn_rng{
+	uint32_t state[4];
+};
+
+/* Initialize the state of the generator, the same seed always generates the
+ * same sequence of numbers
+ */
+void nn_rng_seed(struct nn_rng *rng, unsigned long seed);
+
+/* Generate a random 32-bit number */
+uint32_t nn_rng_next(struct nn_rng *rng);
+/* Generate a random float in the range [0, 1) */
+float nn_rng_float(struct nn_rng *rng);
+/* Generate a random float in the range [start, end) */
+float nn_rng_uniform(struct nn_rng *rng, float start, float end);
+/* Generate a random index in the range [0, count) */
+size_t nn_rng_index(struct nn_rng *rng, size_t count);
+
+/* Fill an array with uniformly distributed floats in the range [start, end),
+ * big arrays are generated with multiple generators in parallel
+ */
+void nn_rng_fill_uniform(struct nn_rng *rng,
+			 float *out,
+			 size_t count,
+			 float start,
+			 float end);
+/* Fill an array with normally distributed floats */
+void nn_rng_fill_gaussian(struct nn_rng *rng,
+			  float *out,
+			  size_t count,
+			  float mean,
+			  float deviation);
+
+/* Advance the generator 2^64 numbers */
+void nn_rng_jump(struct nn_rng *rng);
+
+/* Split off an independent stream, for example one for every thread, the
+ * original generator is advanced so it won't overlap with the new stream
+ */
+struct nn_rng nn_rng_split(struct nn_rng *rng);
+
+/* Derive an independent stream from the generator and an id, for example one
+ * for every genome, the original generator is not changed so the same id
+ * always results in the same stream
+ */
+struct nn_rng nn_rng_derive(const struct nn_rng *rng, unsigned long id);
+
 struct nn_ffnet{
 	size_t ninputs, nhiddens, noutputs, nhidden_layers;
 	size_t nweights, nneurons, nactivations;
@@ -35,9 +86,45 @@ struct nn_ffnet *nn_ffnet_create(size_t input_count,
 				 size_t output_count,
 				 size_t hidden_layer_count);
 
+/* Calculate the amount of bytes a feedforward network with the supplied shape
+ * occupies, this includes the struct and all the data behind it
+ */
+size_t nn_ffnet_get_size(size_t input_count,
+			 size_t hidden_count,
+			 size_t output_count,
+			 size_t hidden_layer_count);
+
+/* Calculate the amount of weights & activations of the supplied shape, these
+ * are the same as the nweights & nactivations fields after creation
+ */
+size_t nn_ffnet_get_weight_count(size_t input_count,
+				 size_t hidden_count,
+				 size_t output_count,
+				 size_t hidden_layer_count);
+size_t nn_ffnet_get_activation_count(size_t hidden_count,
+				     size_t output_count,
+				     size_t hidden_layer_count);
+
+/* Create a new feedforward neural net in already allocated memory
+ * memory:	at least nn_ffnet_get_size bytes, it's not freed by
+ *		nn_ffnet_destroy so it must not be passed to it
+ *
+ * return the memory cast to the zeroed & initialized struct
+ */
+struct nn_ffnet *nn_ffnet_init(void *memory,
+			       size_t input_count,
+			       size_t hidden_count,
+			       size_t output_count,
+			       size_t hidden_layer_count);
+
 /* Copy the feedforward network into a newly allocated one */
 struct nn_ffnet *nn_ffnet_copy(struct nn_ffnet *net);
 
+/* Copy the feedforward network into already allocated memory, the memory
+ * must be at least as big as the size of the network
+ */
+struct nn_ffnet *nn_ffnet_copy_into(void *memory, const struct nn_ffnet *net);
+
 /* Deallocate the memory of the feedforward network */
 void nn_ffnet_destroy(struct nn_ffnet *net);
 
@@ -52,6 +139,13 @@ void nn_ffnet_destroy(struct nn_ffnet *net);
  */
 struct nn_ffnet *nn_ffnet_add_hidden_layer(struct nn_ffnet *net, float weight);
 
+/* Same as nn_ffnet_add_hidden_layer but the result is written in a network
+ * that's already initialized with one hidden layer more than the source
+ */
+void nn_ffnet_add_hidden_layer_into(struct nn_ffnet *new,
+				    const struct nn_ffnet *net,
+				    float weight);
+
 /* Set the activation functions
  * hidden:	for the hidden layers
  * output:	for the output layers
@@ -67,8 +161,8 @@ void nn_ffnet_set_bias(struct nn_ffnet *net, float bias);
 
 void nn_ffnet_set_weights(struct nn_ffnet *net, float weight);
 
-/* Give all the weights in the feedforward network a value between -1 & 1 */
-void nn_ffnet_randomize(struct nn_ffnet *net);
+/* Give all the weights in the feedforward network a value between -0.5 & 0.5 */
+void nn_ffnet_randomize(struct nn_ffnet *net, struct nn_rng *rng);
 
 /* Run the input on the feedforward algorithm to calculate the output
  * inputs:	array of input values, assumed to be the same amount as
@@ -79,6 +173,17 @@ void nn_ffnet_randomize(struct nn_ffnet *net);
  */
 float *nn_ffnet_run(struct nn_ffnet *net, const float *inputs);
 
+/* Same as nn_ffnet_run but the values of the neurons are written to other
+ * memory so the network itself is not changed and can be run by multiple
+ * threads at the same time
+ * neurons:	array of at least nneurons floats
+ *
+ * return the outputs, a pointer into the neurons array
+ */
+float *nn_ffnet_run_into(const struct nn_ffnet *net,
+			 const float *inputs,
+			 float *neurons);
+
 bool nn_ffnet_neuron_is_connected(struct nn_ffnet *net, size_t neuron_id);
 
 size_t nn_ffnet_get_weight_to_neuron(struct nn_ffnet *net, size_t neuron_id);
@@ -0,0 +1,115 @@
+#include "arena.h"
+
+#include <assert.h>
+
+/* Size of the first block, enough for the temporary data of small
+ * populations
+ */
+#define NEAT_ARENA_MINIMUM_SIZE 4096
+
+/* Alignment of every allocation, it's enough for all the basic types */
+#define NEAT_ARENA_ALIGNMENT 16
+
+/* The header of a block is rounded up so the data after it is aligned */
+#define NEAT_ARENA_HEADER_SIZE \
+	((sizeof(struct neat_arena_block) + NEAT_ARENA_ALIGNMENT - 1) / \
+	 NEAT_ARENA_ALIGNMENT * NEAT_ARENA_ALIGNMENT)
+
+static struct neat_arena_block *neat_arena_block_create(size_t size)
+{
+	struct neat_arena_block *block;
+
+	block = malloc(NEAT_ARENA_HEADER_SIZE + size);
+	assert(block);
+	block->next = NULL;
+	block->used = 0;
+	block->size = size;
+
+	return block;
+}
+
+void neat_arena_init(struct neat_arena *arena)
+{
+	assert(arena);
+
+	arena->blocks = NULL;
+	arena->allocated = 0;
+}
+
+void neat_arena_clear(struct neat_arena *arena)
+{
+	struct neat_arena_block *block;
+
+	assert(arena);
+
+	block = arena->blocks;
+	while(block){
+		struct neat_arena_block *next;
+
+		next = block->next;
+		free(block);
+		block = next;
+	}
+
+	neat_arena_init(arena);
+}
+
+void *neat_arena_alloc(struct neat_arena *arena, size_t size)
+{
+	struct neat_arena_block *block;
+	void *memory;
+
+	assert(arena);
+
+	/* Keep the next allocation aligned */
+	size = (size + NEAT_ARENA_ALIGNMENT - 1) /
+		NEAT_ARENA_ALIGNMENT * NEAT_ARENA_ALIGNMENT;
+
+	/* The memory that's already handed out can't be moved, so a new block
+	 * is put in front when the current one is full
+	 */
+	block = arena->blocks;
+	if(!block || block->size - block->used < size){
+		size_t block_size;
+
+		block_size = block ? block->size * 2 : NEAT_ARENA_MINIMUM_SIZE;
+		if(block_size < size){
+			block_size = size;
+		}
+
+		block = neat_arena_block_create(block_size);
+		block->next = arena->blocks;
+		arena->blocks = block;
+	}
+
+	memory = (char*)block + NEAT_ARENA_HEADER_SIZE + block->used;
+	block->used += size;
+	arena->allocated += size;
+
+	return memory;
+}
+
+void neat_arena_reset(struct neat_arena *arena)
+{
+	assert(arena);
+
+	if(!arena->blocks){
+		return;
+	}
+
+	/* Merge the blocks so the next time everything fits in one */
+	if(arena->blocks->next){
+		size_t size;
+
+		size = arena->blocks->size;
+		if(size < arena->allocated){
+			size = arena->allocated;
+		}
+
+		neat_arena_clear(arena);
+		arena->blocks = neat_arena_block_create(size);
+	}
+
+	arena->blocks->used = 0;
+	arena->allocated = 0;
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <stdlib.h>
+
+/* Block of memory an arena allocates from */
+struct neat_arena_block{
+	struct neat_arena_block *next;
+	size_t used, size;
+};
+
+/* Bump allocator for temporary data, allocating only moves a pointer forward
+ * and everything is freed at once with a reset, the memory is kept for the
+ * next use
+ */
+struct neat_arena{
+	/* The block that's allocated from, the older full blocks follow it */
+	struct neat_arena_block *blocks;
+	/* Total amount of bytes that was allocated since the last reset */
+	size_t allocated;
+};
+
+void neat_arena_init(struct neat_arena *arena);
+/* Free all the memory of the arena */
+void neat_arena_clear(struct neat_arena *arena);
+
+/* Allocate memory that's valid until the next reset, it's aligned for every
+ * type and never NULL
+ */
+void *neat_arena_alloc(struct neat_arena *arena, size_t size);
+/* Release everything that was allocated at once, when multiple blocks were
+ * needed they're replaced by one big enough for all of it
+ */
+void neat_arena_reset(struct neat_arena *arena);
@@ -0,0 +1,173 @@
+#include "fenwick.h"
+
+#include <assert.h>
+
+/* Amount of weights a tree has room for when the first one is added */
+#define NEAT_FENWICK_MINIMUM_SIZE 4
+
+/* Lowest set bit of the index, the amount of weights a node sums */
+#define NEAT_FENWICK_RANGE(i) ((i) & (~(i) + 1))
+
+static void neat_fenwick_resize(struct neat_fenwick *fenwick, size_t size)
+{
+	assert(fenwick);
+	assert(size >= fenwick->nitems);
+
+	fenwick->tree = realloc(fenwick->tree, sizeof(double) * (size + 1));
+	assert(fenwick->tree);
+	fenwick->weights = realloc(fenwick->weights, sizeof(double) * size);
+	assert(fenwick->weights);
+	fenwick->size = size;
+}
+
+/* Sum of the first count weights */
+static double neat_fenwick_prefix(const struct neat_fenwick *fenwick,
+				  size_t count)
+{
+	double sum;
+
+	sum = 0.0;
+	while(count > 0){
+		sum += fenwick->tree[count];
+		count -= NEAT_FENWICK_RANGE(count);
+	}
+
+	return sum;
+}
+
+void neat_fenwick_init(struct neat_fenwick *fenwick)
+{
+	assert(fenwick);
+
+	fenwick->tree = fenwick->weights = NULL;
+	fenwick->nitems = fenwick->size = 0;
+}
+
+void neat_fenwick_clear(struct neat_fenwick *fenwick)
+{
+	assert(fenwick);
+
+	free(fenwick->tree);
+	free(fenwick->weights);
+	neat_fenwick_init(fenwick);
+}
+
+void neat_fenwick_push(struct neat_fenwick *fenwick, double weight)
+{
+	size_t node;
+
+	assert(fenwick);
+
+	if(fenwick->nitems == fenwick->size){
+		neat_fenwick_resize(fenwick, fenwick->size > 0 ?
+				    fenwick->size * 2 :
+				    NEAT_FENWICK_MINIMUM_SIZE);
+	}
+
+	/* The new node sums its own weight and the ones in its range before
+	 * it, nodes after it don't exist yet
+	 */
+	node = ++fenwick->nitems;
+	fenwick->weights[node - 1] = weight;
+	fenwick->tree[node] = weight +
+		neat_fenwick_prefix(fenwick, node - 1) -
+		neat_fenwick_prefix(fenwick, node - NEAT_FENWICK_RANGE(node));
+}
+
+void neat_fenwick_pop(struct neat_fenwick *fenwick)
+{
+	assert(fenwick);
+	assert(fenwick->nitems > 0);
+
+	/* No node before the last one includes its weight */
+	fenwick->nitems--;
+
+	if(fenwick->size > NEAT_FENWICK_MINIMUM_SIZE &&
+	   fenwick->nitems <= fenwick->size / 4){
+		neat_fenwick_resize(fenwick, fenwick->size / 2);
+	}
+}
+
+void neat_fenwick_set(struct neat_fenwick *fenwick, size_t index, double weight)
+{
+	double delta;
+	size_t node;
+
+	assert(fenwick);
+	assert(index < fenwick->nitems);
+
+	delta = weight - fenwick->weights[index];
+	fenwick->weights[index] = weight;
+	if(delta == 0.0){
+		return;
+	}
+
+	for(node = index + 1;
+	    node <= fenwick->nitems;
+	    node += NEAT_FENWICK_RANGE(node)){
+		fenwick->tree[node] += delta;
+	}
+}
+
+void neat_fenwick_build(struct neat_fenwick *fenwick)
+{
+	size_t node;
+
+	assert(fenwick);
+
+	for(node = 1; node <= fenwick->nitems; node++){
+		fenwick->tree[node] = fenwick->weights[node - 1];
+	}
+
+	/* Add every node to its parent, which is after it */
+	for(node = 1; node <= fenwick->nitems; node++){
+		size_t parent;
+
+		parent = node + NEAT_FENWICK_RANGE(node);
+		if(parent <= fenwick->nitems){
+			fenwick->tree[parent] += fenwick->tree[node];
+		}
+	}
+}
+
+double neat_fenwick_total(const struct neat_fenwick *fenwick)
+{
+	assert(fenwick);
+
+	return neat_fenwick_prefix(fenwick, fenwick->nitems);
+}
+
+size_t neat_fenwick_search(const struct neat_fenwick *fenwick, double value)
+{
+	size_t index, step;
+
+	assert(fenwick);
+	assert(fenwick->nitems > 0);
+
+	step = 1;
+	while(step * 2 <= fenwick->nitems){
+		step *= 2;
+	}
+
+	/* Walk down the tree, skipping every range that sums to at most the
+	 * value
+	 */
+	index = 0;
+	for(; step > 0; step /= 2){
+		if(index + step <= fenwick->nitems &&
+		   fenwick->tree[index + step] <= value){
+			index += step;
+			value -= fenwick->tree[index];
+		}
+	}
+
+	/* Rounding errors can move it past the end or onto an empty weight */
+	if(index == fenwick->nitems){
+		index--;
+	}
+	while(index > 0 && fenwick->weights[index] <= 0.0){
+		index--;
+	}
+
+	return index;
+}
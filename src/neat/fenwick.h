@@ -0,0 +1,28 @@
+#pragma once
+
+#include <stdlib.h>
+
+/* Fenwick tree of weights where a weight can be changed and an index can be
+ * picked proportional to its weight in logarithmic time
+ */
+struct neat_fenwick{
+	/* The tree starts at index 1, the weights at index 0 */
+	double *tree, *weights;
+	size_t nitems, size;
+};
+
+void neat_fenwick_init(struct neat_fenwick *fenwick);
+void neat_fenwick_clear(struct neat_fenwick *fenwick);
+
+void neat_fenwick_push(struct neat_fenwick *fenwick, double weight);
+/* Remove the last weight */
+void neat_fenwick_pop(struct neat_fenwick *fenwick);
+void neat_fenwick_set(struct neat_fenwick *fenwick, size_t index, double weight);
+/* Sum all the weights again to get rid of rounding errors */
+void neat_fenwick_build(struct neat_fenwick *fenwick);
+
+double neat_fenwick_total(const struct neat_fenwick *fenwick);
+/* Return the index where the sum of the weights before it is at most the value
+ * and the sum including it is larger
+ */
+size_t neat_fenwick_search(const struct neat_fenwick *fenwick, double value);
@@ -1,121 +1,493 @@
 #include "genome.h"
 
+#include "parallel.h"
+#include "kernel.h"
+#include "stream.h"
+
 #include <string.h>
+#include <limits.h>
 #include <stdint.h>
 #include <math.h>
 #include <assert.h>
 
-static float neat_random_two(void)
+/* Amount of random weights generated on the stack at a time */
+#define NEAT_GENOME_RANDOM_CHUNK 256
+
+static float neat_random_two(struct nn_rng *rng)
+{
+	return nn_rng_uniform(rng, -2.0f, 2.0f);
+}
+
+/* Index of the first weight going into the layer, the output layer comes after
+ * the hidden layers and the layer after that ends at the last weight
+ */
+static size_t neat_genome_layer_weight_start(const struct nn_ffnet *n,
+					     size_t layer)
+{
+	assert(n);
+	assert(layer <= n->nhidden_layers + 1);
+
+	if(layer == 0){
+		return 0;
+	}
+	if(layer > n->nhidden_layers){
+		return n->nweights;
+	}
+
+	return (n->ninputs + 1) * n->nhiddens +
+		(n->nhiddens + 1) * n->nhiddens * (layer - 1);
+}
+
+static size_t neat_genome_weight_layer(const struct nn_ffnet *n,
+				       size_t weight_id)
+{
+	size_t input_weights, layer;
+
+	assert(n);
+	assert(weight_id < n->nweights);
+
+	if(n->nhidden_layers == 0){
+		return 0;
+	}
+
+	input_weights = (n->ninputs + 1) * n->nhiddens;
+	if(weight_id < input_weights){
+		return 0;
+	}
+
+	/* The output layer can have more weights than a hidden layer */
+	layer = 1 + (weight_id - input_weights) /
+		((n->nhiddens + 1) * n->nhiddens);
+	if(layer > n->nhidden_layers){
+		layer = n->nhidden_layers;
+	}
+
+	return layer;
+}
+
+static size_t neat_genome_activation_layer(const struct nn_ffnet *n,
+					   size_t activ_id)
 {
-	return (float)rand() / (float)(RAND_MAX / 4.0f) - 2.0f;
+	size_t layer;
+
+	assert(n);
+	assert(activ_id < n->nactivations);
+
+	layer = activ_id / n->nhiddens;
+	if(layer > n->nhidden_layers){
+		layer = n->nhidden_layers;
+	}
+
+	return layer;
+}
+
+/* Mix the bits of the value so every input bit affects every output bit
+ * (the finalizer of splitmix64)
+ */
+static uint64_t neat_genome_mix(uint64_t value)
+{
+	value ^= value >> 30;
+	value *= (uint64_t)0xbf58476d1ce4e5b9UL;
+	value ^= value >> 27;
+	value *= (uint64_t)0x94d049bb133111ebUL;
+	value ^= value >> 31;
+
+	return value;
 }
 
-static void neat_genome_zeroify_innovations(struct neat_genome *genome)
+/* The fingerprint is the XOR of the hashes of all the weights & activations so
+ * a single one can be changed by XORing the old and the new hash, unused ones
+ * hash to 0 so they don't need to be visited
+ */
+static uint64_t neat_genome_hash_weight(size_t weight_id, float weight)
 {
+	uint32_t bits;
+
+	if(weight == 0.0f){
+		return 0;
+	}
+
+	memcpy(&bits, &weight, sizeof(bits));
+
+	return neat_genome_mix(((uint64_t)weight_id << 32 | bits) ^
+			       (uint64_t)0x9e3779b97f4a7c15UL);
+}
+
+static uint64_t neat_genome_hash_activation(size_t activ_id, char activation)
+{
+	if(activation == NN_ACTIVATION_PASSTHROUGH){
+		return 0;
+	}
+
+	return neat_genome_mix(((uint64_t)activ_id << 32 |
+				(unsigned char)activation) ^
+			       (uint64_t)0xc2b2ae3d27d4eb4fUL);
+}
+
+/* Calculate the fingerprint from scratch, this is only needed when all the
+ * weights changed anyway
+ */
+static void neat_genome_fingerprint(struct neat_genome *genome)
+{
+	const struct nn_ffnet *n;
+	uint64_t fingerprint;
+	uint32_t bias;
 	size_t i;
 
 	assert(genome);
 	assert(genome->net);
 
-	/* Set the weight innovations to 0 if the value of the weight is 0.0 */
-	genome->used_weights = 0;
-	for(i = 0; i < genome->ninnov_weights; i++){
-		int weight_is_set;
+	n = genome->net;
 
-		/* Set the innovation to 0 if the weight is 0 */
-		weight_is_set = genome->net->weight[i] != 0;
-		genome->innov_weight[i] *= weight_is_set;
-		genome->used_weights += weight_is_set;
+	memcpy(&bias, &n->bias, sizeof(bias));
+	fingerprint = neat_genome_mix(((uint64_t)n->ninputs << 48) ^
+				      ((uint64_t)n->nhiddens << 32) ^
+				      ((uint64_t)n->noutputs << 16) ^
+				      (uint64_t)n->nhidden_layers);
+	fingerprint ^= neat_genome_mix(bias);
+
+	for(i = 0; i < n->nweights; i++){
+		fingerprint ^= neat_genome_hash_weight(i, n->weight[i]);
+	}
+	for(i = 0; i < n->nactivations; i++){
+		fingerprint ^= neat_genome_hash_activation(i, n->activation[i]);
 	}
 
-	/* Set the weight innovations to 0 if the value of the weight is 0.0 */
-	genome->used_activs = 0;
-	for(i = 0; i < genome->ninnov_activs; i++){
-		int activ_is_not_passthrough;
+	genome->fingerprint = fingerprint;
+}
 
-		/* Set the innovation to 0 if the weight is 0 */
-		activ_is_not_passthrough = genome->net->activation[i] != 0;
-		genome->innov_activ[i] *= activ_is_not_passthrough;
-		genome->used_activs += activ_is_not_passthrough;
+/* Change a weight and keep the innovation and the counts in sync with it */
+static void neat_genome_set_weight(struct neat_genome *genome,
+				   size_t weight_id,
+				   float weight,
+				   int innovation)
+{
+	bool was_set, is_set;
+	size_t layer;
+
+	assert(genome);
+	assert(weight_id < genome->ninnov_weights);
+
+	was_set = genome->net->weight[weight_id] != 0.0f;
+	is_set = weight != 0.0f;
+
+	genome->fingerprint ^=
+		neat_genome_hash_weight(weight_id,
+					genome->net->weight[weight_id]) ^
+		neat_genome_hash_weight(weight_id, weight);
+
+	/* Unset weights are always a positive zero */
+	genome->net->weight[weight_id] = is_set ? weight : 0.0f;
+	genome->innov_weight[weight_id] = is_set ? innovation : 0;
+
+	if(was_set == is_set){
+		return;
+	}
+
+	layer = neat_genome_weight_layer(genome->net, weight_id);
+	if(is_set){
+		genome->used_weights++;
+		genome->layer_weights[layer]++;
+	}else{
+		genome->used_weights--;
+		genome->layer_weights[layer]--;
+	}
+}
+
+static void neat_genome_set_activation(struct neat_genome *genome,
+				       size_t activ_id,
+				       enum nn_activation activation,
+				       int innovation)
+{
+	bool was_set, is_set;
+	size_t layer;
+
+	assert(genome);
+	assert(activ_id < genome->ninnov_activs);
+
+	was_set = genome->net->activation[activ_id] !=
+		NN_ACTIVATION_PASSTHROUGH;
+	is_set = activation != NN_ACTIVATION_PASSTHROUGH;
+
+	genome->fingerprint ^=
+		neat_genome_hash_activation(activ_id,
+					    genome->net->activation[activ_id]) ^
+		neat_genome_hash_activation(activ_id, (char)activation);
+
+	genome->net->activation[activ_id] = (char)activation;
+	genome->innov_activ[activ_id] = is_set ? innovation : 0;
+
+	if(was_set == is_set){
+		return;
 	}
 
-	/*TODO make the used_activs and used_weights more sensible */
+	layer = neat_genome_activation_layer(genome->net, activ_id);
+	if(is_set){
+		genome->used_activs++;
+		genome->layer_activs[layer]++;
+	}else{
+		genome->used_activs--;
+		genome->layer_activs[layer]--;
+	}
 }
 
-static size_t neat_genome_allocate_innovations(struct neat_genome *genome,
-					       int innovation)
+/* Count the used weights & activations of a layer and clear the innovations of
+ * the unused ones, this is only needed for layers that are built from scratch
+ */
+static void neat_genome_count_layer(struct neat_genome *genome, size_t layer)
 {
-	int *innov;
-	size_t bytes, diff, i;
+	const struct nn_ffnet *n;
+	size_t i, start, end, used;
 
 	assert(genome);
 	assert(genome->net);
 
-	/* Allocate the weight innovations */
-	bytes = sizeof(int) * genome->net->nweights;
-	assert(bytes > 0);
-	genome->innov_weight = realloc(genome->innov_weight, bytes);
-	assert(genome->innov_weight);
+	n = genome->net;
+	assert(layer <= n->nhidden_layers);
+
+	start = neat_genome_layer_weight_start(n, layer);
+	end = neat_genome_layer_weight_start(n, layer + 1);
+	used = neat_kernel_mask_innovations(genome->innov_weight + start,
+					    n->weight + start,
+					    end - start);
+	genome->used_weights += used - genome->layer_weights[layer];
+	genome->layer_weights[layer] = used;
+
+	start = layer * n->nhiddens;
+	end = layer == n->nhidden_layers ? n->nactivations : start + n->nhiddens;
+	used = 0;
+	for(i = start; i < end; i++){
+		int activ_is_not_passthrough;
 
-	/* Set the newly allocated part to the current innovation */
-	diff = genome->net->nweights - genome->ninnov_weights;
-	innov = genome->innov_weight + genome->ninnov_weights;
-	for(i = 0; i < diff; i++){
-		*innov++ = innovation;
+		/* Set the innovation to 0 if the activation is passthrough */
+		activ_is_not_passthrough = n->activation[i] !=
+			NN_ACTIVATION_PASSTHROUGH;
+		genome->innov_activ[i] *= activ_is_not_passthrough;
+		used += activ_is_not_passthrough;
 	}
+	genome->used_activs += used - genome->layer_activs[layer];
+	genome->layer_activs[layer] = used;
+}
+
+static size_t neat_genome_get_size(size_t ninputs,
+				   size_t nhiddens,
+				   size_t noutputs,
+				   size_t nhidden_layers,
+				   size_t *innov_offset,
+				   size_t *layer_offset)
+{
+	size_t offset, ninnovs;
+
+	assert(innov_offset);
+	assert(layer_offset);
+
+	/* The network is placed directly behind the genome struct */
+	offset = sizeof(struct neat_genome);
+	offset += nn_ffnet_get_size(ninputs, nhiddens, noutputs, nhidden_layers);
+
+	/* Align the innovations, the network ends with the activation chars */
+	offset = (offset + sizeof(int) - 1) / sizeof(int) * sizeof(int);
+	*innov_offset = offset;
+
+	ninnovs = nn_ffnet_get_weight_count(ninputs,
+					    nhiddens,
+					    noutputs,
+					    nhidden_layers);
+	ninnovs += nn_ffnet_get_activation_count(nhiddens,
+						 noutputs,
+						 nhidden_layers);
+	offset += sizeof(int) * ninnovs;
+
+	/* The weight and activation counts of every layer */
+	offset = (offset + sizeof(size_t) - 1) / sizeof(size_t) * sizeof(size_t);
+	*layer_offset = offset;
+
+	return offset + sizeof(size_t) * 2 * (nhidden_layers + 1);
+}
+
+static void neat_genome_set_pointers(struct neat_genome *genome,
+				     size_t innov_offset,
+				     size_t layer_offset)
+{
+	assert(genome);
+	assert(genome->net);
+
+	genome->innov_weight = (int*)((char*)genome + innov_offset);
+	genome->innov_activ = genome->innov_weight + genome->ninnov_weights;
+
+	genome->layer_weights = (size_t*)((char*)genome + layer_offset);
+	genome->layer_activs = genome->layer_weights +
+		genome->net->nhidden_layers + 1;
+}
+
+/* Allocate a genome with the network and the innovations in one block:
+ * [ **struct**, **network struct**, network data.., weight innovations..,
+ *   activation innovations.., layer weight counts.., layer activation
+ *   counts.. ]
+ */
+static struct neat_genome *neat_genome_allocate(struct neat_pool *pool,
+						size_t ninputs,
+						size_t nhiddens,
+						size_t noutputs,
+						size_t nhidden_layers)
+{
+	struct neat_genome *genome;
+	size_t bytes, innov_offset, layer_offset;
+
+	assert(pool);
+
+	bytes = neat_genome_get_size(ninputs,
+				     nhiddens,
+				     noutputs,
+				     nhidden_layers,
+				     &innov_offset,
+				     &layer_offset);
+
+	genome = neat_pool_alloc(pool, bytes);
+	assert(genome);
+
+	memset(genome, 0, sizeof(struct neat_genome));
+	genome->bytes = bytes;
+	genome->refs = 1;
+
+	genome->net = nn_ffnet_init((char*)genome + sizeof(struct neat_genome),
+				    ninputs,
+				    nhiddens,
+				    noutputs,
+				    nhidden_layers);
 
 	genome->ninnov_weights = genome->net->nweights;
+	genome->ninnov_activs = genome->net->nactivations;
+	neat_genome_set_pointers(genome, innov_offset, layer_offset);
+
+	/* Clear the innovations and the counts, the network is empty */
+	memset(genome->innov_weight, 0, bytes - innov_offset);
+
+	return genome;
+}
+
+static struct neat_genome *neat_genome_make_writable(struct neat_pool *pool,
+						     struct neat_genome *genome)
+{
+	struct neat_genome *copy;
+	bool shared;
+
+	assert(genome);
 
-	/* Allocate the activation innovations */
-	bytes = sizeof(int) * genome->net->nactivations;
-	assert(bytes > 0);
-	genome->innov_activ = realloc(genome->innov_activ, bytes);
-	assert(genome->innov_activ);
+	neat_pool_lock(pool);
+	assert(genome->refs > 0);
+	shared = genome->refs > 1;
+	neat_pool_unlock(pool);
 
-	/* Set the newly allocated part to the current innovation */
-	diff = genome->net->nactivations - genome->ninnov_activs;
-	innov = genome->innov_activ + genome->ninnov_activs;
-	for(i = 0; i < diff; i++){
-		*innov++ = innovation;
+	/* Nobody else uses it so it can be changed in place */
+	if(!shared){
+		return genome;
 	}
 
-	genome->ninnov_activs = genome->net->nactivations;
+	/* Nobody changes the genome while it's shared so it can be copied
+	 * without holding the lock, the release frees it when another thread
+	 * copied it at the same time
+	 */
+	copy = neat_genome_copy(pool, genome);
+	neat_genome_destroy(pool, genome);
 
-	return bytes;
+	return copy;
 }
 
-static void neat_genome_add_layer(struct neat_genome *genome, int innovation)
+static struct neat_genome *neat_genome_add_layer(struct neat_pool *pool,
+						 struct neat_genome *genome,
+						 int innovation)
 {
-	size_t i;
+	struct neat_genome *new;
+	const struct nn_ffnet *n;
+	size_t nhidden_activs, nold_weights, noutput_weights;
+	size_t new_layer, start, end;
 
 	assert(genome);
 	assert(genome->net);
-	
-	genome->net = nn_ffnet_add_hidden_layer(genome->net, 1.0);
-	assert(genome->net);
 
-	/* First realloc the innovation lists to the new size */
-	neat_genome_allocate_innovations(genome, innovation);
+	n = genome->net;
 
-	/* Then set all the innovations that are zero to the current innovation
-	 * so the last step can clear the unused ones
+	/* The genome doesn't fit in the old block anymore so a bigger one
+	 * is created
 	 */
-	for(i = 0; i < genome->ninnov_weights; i++){
-		if(genome->innov_weight[i] != 0){
-			genome->innov_weight[i] = innovation;
-		}
-	}
+	new = neat_genome_allocate(pool,
+				   n->ninputs,
+				   n->nhiddens,
+				   n->noutputs,
+				   n->nhidden_layers + 1);
+
+	nn_ffnet_add_hidden_layer_into(new->net, n, 1.0);
+	new->net->bias = n->bias;
 
-	/* Finally clear all the innovations that aren't used (where for example
-	 * the weight is zero)
+	/* Move the innovations the same way as the weights, the new layer is
+	 * placed between the hidden and the output weights
+	 */
+	new_layer = n->nhidden_layers;
+	nold_weights = neat_genome_layer_weight_start(n, new_layer);
+	noutput_weights = n->nweights - nold_weights;
+	memcpy(new->innov_weight,
+	       genome->innov_weight,
+	       sizeof(int) * nold_weights);
+	memcpy(new->innov_weight + new->ninnov_weights - noutput_weights,
+	       genome->innov_weight + nold_weights,
+	       sizeof(int) * noutput_weights);
+
+	/* Keep the activation innovations of the existing layers, the new
+	 * layer is placed between the hidden and the output activations
 	 */
-	neat_genome_zeroify_innovations(genome);
+	nhidden_activs = n->nactivations - n->noutputs;
+	memcpy(new->innov_activ,
+	       genome->innov_activ,
+	       sizeof(int) * nhidden_activs);
+	memcpy(new->innov_activ + nhidden_activs + n->nhiddens,
+	       genome->innov_activ + nhidden_activs,
+	       sizeof(int) * n->noutputs);
+
+	/* The existing hidden layers didn't change */
+	memcpy(new->layer_weights,
+	       genome->layer_weights,
+	       sizeof(size_t) * new_layer);
+	memcpy(new->layer_activs,
+	       genome->layer_activs,
+	       sizeof(size_t) * new_layer);
+	new->used_weights = genome->used_weights -
+		genome->layer_weights[new_layer];
+	new->used_activs = genome->used_activs -
+		genome->layer_activs[new_layer];
+
+	/* Only the weights of the new layer are new genes, its activations
+	 * are all passthrough
+	 */
+	start = neat_genome_layer_weight_start(new->net, new_layer);
+	end = neat_genome_layer_weight_start(new->net, new_layer + 1);
+	new->layer_weights[new_layer] =
+		neat_kernel_set_innovations(new->innov_weight + start,
+					    new->net->weight + start,
+					    end - start,
+					    innovation);
+	new->used_weights += new->layer_weights[new_layer];
+
+	/* The output layer is counted again because it's connected to a layer
+	 * with a different size when the first hidden layer is added
+	 */
+	neat_genome_count_layer(new, new_layer + 1);
+
+	/* All the weights moved so they all hash differently */
+	neat_genome_fingerprint(new);
+
+	/* Release the old genome, other organisms might still share it */
+	neat_genome_destroy(pool, genome);
+
+	return new;
 }
 
-static void neat_genome_add_neuron(struct neat_genome *genome,
-				   int innovation,
-				   enum nn_activation default_hidden,
-				   enum nn_activation default_output)
+static struct neat_genome *neat_genome_add_neuron(struct neat_pool *pool,
+						  struct nn_rng *rng,
+						  struct neat_genome *genome,
+						  int innovation,
+						  enum nn_activation default_hidden,
+						  enum nn_activation default_output)
 {
 	struct nn_ffnet *n;
 	size_t i, layer, start_offset;
@@ -127,14 +499,16 @@ static void neat_genome_add_neuron(struct neat_genome *genome,
 	assert(n->nhiddens > 0);
 
 	/* Add + 1 to the selection of the layer so a new one can be created */
-	layer = rand() % (n->nhidden_layers + 1);
+	layer = nn_rng_index(rng, n->nhidden_layers + 1);
 	if(layer >= n->nhidden_layers){
-		neat_genome_add_layer(genome, innovation);
-		/* Make sure to reassign the pointer since adding a layer
-		 * creates a new network
-		 */
-		n = genome->net;
+		genome = neat_genome_add_layer(pool, genome, innovation);
+	}else{
+		genome = neat_genome_make_writable(pool, genome);
 	}
+	/* Make sure to reassign the pointer since adding a layer creates a new
+	 * network and a shared genome is copied
+	 */
+	n = genome->net;
 
 	/* Start at the begin of the layer for the neurons */
 	start_offset = n->ninputs + layer * n->nhiddens;
@@ -142,35 +516,43 @@ static void neat_genome_add_neuron(struct neat_genome *genome,
 	/* Add a random offset so not the same vertical layer will be chosen
 	 * every time
 	 */
-	start_offset += rand() % n->nhiddens;
+	start_offset += nn_rng_index(rng, n->nhiddens);
 
 	/* Find the first disconnected layer starting from the selected layer
 	 * and set the weight value to a random previous neuron
 	 */
 	for(i = start_offset; i < n->nneurons; i++){
 		size_t activ_offset;
-		char *activ;
+		enum nn_activation activation;
 
 		activ_offset = i - n->ninputs;
-		activ = n->activation + activ_offset;
-		if(*activ == NN_ACTIVATION_PASSTHROUGH){
-			if(layer == n->nhidden_layers){
-				/* Set the output activation if it's the last
-				 * layer
-				 */
-				*activ = default_output;
-			}else{
-				*activ = default_hidden;
-			}
-			genome->innov_activ[activ_offset] = innovation;
-			genome->used_activs++;
+		if(n->activation[activ_offset] != NN_ACTIVATION_PASSTHROUGH){
+			continue;
+		}
 
-			return;
+		/* Set the output activation if the neuron is in the last
+		 * layer
+		 */
+		if(neat_genome_activation_layer(n, activ_offset) ==
+		   n->nhidden_layers){
+			activation = default_output;
+		}else{
+			activation = default_hidden;
 		}
+		neat_genome_set_activation(genome,
+					   activ_offset,
+					   activation,
+					   innovation);
+
+		break;
 	}
+
+	return genome;
 }
 
-static void neat_genome_add_link(struct neat_genome *genome, int innovation)
+static void neat_genome_add_link(struct nn_rng *rng,
+				 struct neat_genome *genome,
+				 int innovation)
 {
 	size_t available, select_weight_offset, i;
 
@@ -187,7 +569,7 @@ static void neat_genome_add_link(struct neat_genome *genome, int innovation)
 	/* Get a random number between the start and the end of all available
 	 * weights
 	 */
-	select_weight_offset = rand() % available;
+	select_weight_offset = nn_rng_index(rng, available);
 
 	/* Loop over the available weight to find the randomly selected one */
 	for(i = 0; i < genome->net->nweights; i++){
@@ -200,15 +582,17 @@ static void neat_genome_add_link(struct neat_genome *genome, int innovation)
 		 * one is found
 		 */
 		if(!select_weight_offset--){
-			genome->net->weight[i] = neat_random_two();
-			genome->innov_weight[i] = innovation;
-			genome->used_weights++;
+			neat_genome_set_weight(genome,
+					       i,
+					       neat_random_two(rng),
+					       innovation);
 			return;
 		}
 	}
 }
 
-static void neat_genome_mutate_activation(struct neat_genome *genome,
+static void neat_genome_mutate_activation(struct nn_rng *rng,
+					  struct neat_genome *genome,
 					  int innovation)
 {
 	size_t random_activ;
@@ -217,29 +601,25 @@ static void neat_genome_mutate_activation(struct neat_genome *genome,
 	assert(genome);
 	assert(genome->net);
 
-	random_activ = rand() % genome->net->nactivations;
+	random_activ = nn_rng_index(rng, genome->net->nactivations);
 
 	/* TODO make the new activation never be passthrough */
 	/* Randomly select a new activation function */
-	new_activation = rand() % _NN_ACTIVATION_COUNT;
+	new_activation = nn_rng_index(rng, _NN_ACTIVATION_COUNT);
 
 	/* If the activation is the same as the last one just increment it */
 	if(genome->net->activation[random_activ] == new_activation){
 		new_activation = (new_activation + 1) % _NN_ACTIVATION_COUNT;
 	}
 
-	/* A change from passthrough to another type of activation counts as
-	 * using it
-	 */
-	if(genome->net->activation[random_activ] == NN_ACTIVATION_PASSTHROUGH){
-		genome->used_activs++;
-	}
-
-	genome->net->activation[random_activ] = new_activation;
-	genome->innov_activ[random_activ] = innovation;
+	neat_genome_set_activation(genome,
+				   random_activ,
+				   (enum nn_activation)new_activation,
+				   innovation);
 }
 
-static void neat_genome_mutate_weight(struct neat_genome *genome,
+static void neat_genome_mutate_weight(struct nn_rng *rng,
+				      struct neat_genome *genome,
 				      int innovation)
 {
 	size_t select_weight_offset, i;
@@ -251,115 +631,184 @@ static void neat_genome_mutate_weight(struct neat_genome *genome,
 		return;
 	}
 
-	select_weight_offset = rand() % genome->used_weights;
+	select_weight_offset = nn_rng_index(rng, genome->used_weights);
 
 	/* Loop over the available weight to find the randomly selected one */
 	for(i = 0; i < genome->net->nweights; i++){
 		if(genome->net->weight[i] != 0.0f && !select_weight_offset--){
-			genome->net->weight[i] = neat_random_two();
-			genome->innov_weight[i] = innovation;
+			neat_genome_set_weight(genome,
+					       i,
+					       neat_random_two(rng),
+					       innovation);
 			return;
 		}
 	}
 }
 
-static void neat_genome_mutate_all_weights(struct neat_genome *genome,
+static void neat_genome_mutate_all_weights(struct nn_rng *rng,
+					   struct neat_genome *genome,
 					   int innovation)
 {
-	size_t i;
+	float random[NEAT_GENOME_RANDOM_CHUNK];
+	size_t layer, i, j, n, end, lost;
 
 	assert(genome);
 	assert(genome->net);
 
-	for(i = 0; i < genome->net->nweights; i++){
-		float *weight;
+	/* Generate the random weights in chunks and only use them where the
+	 * weight is set, there are no branches so it can be vectorized, it's
+	 * done per layer so the weights that become exactly 0 can be subtracted
+	 * from the right count
+	 */
+	for(layer = 0; layer <= genome->net->nhidden_layers; layer++){
+		i = neat_genome_layer_weight_start(genome->net, layer);
+		end = neat_genome_layer_weight_start(genome->net, layer + 1);
+		lost = 0;
+		for(; i < end; i += n){
+			float *weight;
+			int *innov;
+
+			n = end - i;
+			if(n > NEAT_GENOME_RANDOM_CHUNK){
+				n = NEAT_GENOME_RANDOM_CHUNK;
+			}
+
+			nn_rng_fill_uniform(rng, random, n, -2.0f, 2.0f);
 
-		weight = genome->net->weight + i;
-		if(*weight != 0.0f){
-			*weight = neat_random_two();
-			genome->innov_weight[i] = innovation;
+			weight = genome->net->weight + i;
+			innov = genome->innov_weight + i;
+			for(j = 0; j < n; j++){
+				int was_set, is_set;
+
+				/* Unset weights are zero so they stay zero, adding
+				 * zero turns a negative zero into a positive one
+				 */
+				was_set = weight[j] != 0.0f;
+				weight[j] = random[j] * (float)was_set + 0.0f;
+				is_set = weight[j] != 0.0f;
+				innov[j] = innovation * is_set;
+				lost += was_set - is_set;
+			}
 		}
+
+		genome->layer_weights[layer] -= lost;
+		genome->used_weights -= lost;
 	}
+
+	neat_genome_fingerprint(genome);
 }
 
-struct neat_genome *neat_genome_create(struct neat_config config,
+struct neat_genome *neat_genome_create(struct neat_pool *pool,
+				       struct nn_rng *rng,
+				       struct neat_config config,
 				       int innovation)
 {
 	struct neat_genome *genome;
 	size_t i;
 
+	assert(pool);
 	assert(innovation > 0);
 	assert(config.network_inputs > 0);
 	assert(config.network_hidden_nodes > 0);
 	assert(config.network_outputs > 0);
 
-	genome = calloc(1, sizeof(struct neat_genome));
-	assert(genome);
-
-	genome->net = nn_ffnet_create(config.network_inputs,
+	genome = neat_genome_allocate(pool,
+				      config.network_inputs,
 				      config.network_hidden_nodes,
 				      config.network_outputs,
 				      0);
-	assert(genome->net);
+	assert(genome);
 
 	nn_ffnet_set_activations(genome->net,
 				 config.genome_default_hidden_activation,
 				 config.genome_default_output_activation);
 
-	nn_ffnet_randomize(genome->net);
+	nn_ffnet_randomize(genome->net, rng);
 
 	nn_ffnet_set_bias(genome->net, -1.0f);
 
-	neat_genome_allocate_innovations(genome, innovation);
 	for(i = 0; i < genome->ninnov_weights; i++){
 		genome->innov_weight[i] = innovation;
 	}
 	for(i = 0; i < genome->ninnov_activs; i++){
 		genome->innov_activ[i] = innovation;
 	}
-	neat_genome_zeroify_innovations(genome);
+	/* There are no hidden layers yet, only the output layer is counted */
+	neat_genome_count_layer(genome, 0);
+	neat_genome_fingerprint(genome);
 
 	return genome;
 }
 
-struct neat_genome *neat_genome_copy(const struct neat_genome *genome)
+static void neat_genome_copy_contents(struct neat_genome *dest,
+				      const struct neat_genome *src)
+{
+	assert(dest);
+	assert(src);
+	assert(dest->bytes == src->bytes);
+	assert(dest->net->nhidden_layers == src->net->nhidden_layers);
+
+	nn_ffnet_copy_into(dest->net, src->net);
+
+	/* The innovations and the layer counts fill the rest of the block */
+	memcpy(dest->innov_weight,
+	       src->innov_weight,
+	       src->bytes - (size_t)((const char*)src->innov_weight -
+				     (const char*)src));
+
+	dest->used_weights = src->used_weights;
+	dest->used_activs = src->used_activs;
+	dest->fingerprint = src->fingerprint;
+}
+
+struct neat_genome *neat_genome_copy(struct neat_pool *pool,
+				     const struct neat_genome *genome)
 {
 	struct neat_genome *new;
-	size_t bytes;
+	const struct nn_ffnet *n;
 
-	new = calloc(1, sizeof(struct neat_genome));
-	assert(new);
+	assert(pool);
+	assert(genome);
 
-	new->net = nn_ffnet_copy(genome->net);
-	assert(new->net);
+	n = genome->net;
+	new = neat_genome_allocate(pool,
+				   n->ninputs,
+				   n->nhiddens,
+				   n->noutputs,
+				   n->nhidden_layers);
 
-	bytes = neat_genome_allocate_innovations(new, 1);
-	memcpy(new->innov_weight, genome->innov_weight, bytes);
-	assert(new->innov_weight);
+	neat_genome_copy_contents(new, genome);
 
 	return new;
 }
 
-struct neat_genome *neat_genome_reproduce(const struct neat_genome *parent1,
+struct neat_genome *neat_genome_reproduce(struct neat_pool *pool,
+					  struct neat_genome *dest,
+					  const struct neat_genome *parent1,
 					  const struct neat_genome *parent2)
 {
 	struct neat_genome *child;
-	size_t i, min_weights;
+	size_t min_weights, layer;
 
 	assert(parent1);
 	assert(parent2);
+	assert(dest != parent1);
+	assert(dest != parent2);
 
-	/* Take the most fit parent as the base */
-	if(parent2->fitness > parent1->fitness){
-		const struct neat_genome *tmp;
-
-		tmp = parent1;
-		parent1 = parent2;
-		parent2 = tmp;
+	/* The most fit parent is the base, write it directly over the
+	 * destination if nobody else uses it and it has the same shape
+	 */
+	if(dest && dest->refs == 1 &&
+	   dest->net->nhidden_layers == parent1->net->nhidden_layers){
+		child = dest;
+		neat_genome_copy_contents(child, parent1);
+	}else{
+		if(dest){
+			neat_genome_destroy(pool, dest);
+		}
+		child = neat_genome_copy(pool, parent1);
 	}
 
-	child = neat_genome_copy(parent1);
-
 	/* Iterate until the least amount of weights, if there any excess
 	 * weights for the child then they are inherited automatically
 	 */
@@ -368,38 +817,47 @@ struct neat_genome *neat_genome_reproduce(const struct neat_genome *parent1,
 		min_weights = parent2->ninnov_weights;
 	}
 
-	for(i = 0; i < min_weights; i++){
-		int in1, in2;
-		float weight1, weight2;
+	/* Take the average of the matching genes (blended crossover), disjoint
+	 * genes will be automatically chosen from the fittest genome
+	 * TODO choose between average and random based on chance (uniform
+	 * crossover)
+	 */
+	for(layer = 0; layer <= child->net->nhidden_layers; layer++){
+		size_t start, end, lost;
 
-		in1 = parent1->innov_weight[i];
-		in2 = parent2->innov_weight[i];
-		if(in1 != in2){
-			/* Disjoint genes will be automatically chosen from the
-			 * fittest genome
-			 */
-			continue;
+		start = neat_genome_layer_weight_start(child->net, layer);
+		end = neat_genome_layer_weight_start(child->net, layer + 1);
+		if(start >= min_weights){
+			break;
+		}
+		if(end > min_weights){
+			end = min_weights;
 		}
 
-		/* Matching genes */
-		weight1 = parent1->net->weight[i];
-		weight2 = parent2->net->weight[i];
-
-		/* Take the average (blended crossover) */
-		child->net->weight[i] = (weight1 + weight2) / 2.0f;
-		/* TODO choose between average and random based
-		 * on chance (uniform crossover)
-		 */
+		/* Two weights can cancel each other out */
+		lost = neat_kernel_blend_matching(child->net->weight + start,
+						  child->innov_weight + start,
+						  parent1->net->weight + start,
+						  parent2->net->weight + start,
+						  parent1->innov_weight + start,
+						  parent2->innov_weight + start,
+						  end - start);
+		child->layer_weights[layer] -= lost;
+		child->used_weights -= lost;
 	}
 
 	/* TODO also do this for the activations */
 
+	neat_genome_fingerprint(child);
+
 	return child;
 }
 
-void neat_genome_mutate(struct neat_genome *genome,
-			struct neat_config config,
-			int innovation)
+struct neat_genome *neat_genome_mutate(struct neat_pool *pool,
+				       struct nn_rng *rng,
+				       struct neat_genome *genome,
+				       struct neat_config config,
+				       int innovation)
 {
 	float random;
 
@@ -410,53 +868,547 @@ void neat_genome_mutate(struct neat_genome *genome,
 	if(genome->net->nhidden_layers == 0){
 		random = 0.0f;
 	}else{
-		random = (float)rand() / (float)RAND_MAX;
+		random = nn_rng_float(rng);
 	}
 	if(random <= config.genome_add_neuron_mutation_probability){
-		neat_genome_add_neuron(genome,
-				       innovation,
-				       config.genome_default_hidden_activation,
-				       config.genome_default_output_activation);
-		return;
+		return neat_genome_add_neuron(pool,
+					      rng,
+					      genome,
+					      innovation,
+					      config.genome_default_hidden_activation,
+					      config.genome_default_output_activation);
 	}
 
-	random = (float)rand() / (float)RAND_MAX;
+	/* Every mutation below changes the genome so it can't be shared
+	 * anymore
+	 */
+	random = nn_rng_float(rng);
 	if(random < config.genome_add_link_mutation_probability){
-		neat_genome_add_link(genome, innovation);
-		return;
+		genome = neat_genome_make_writable(pool, genome);
+		neat_genome_add_link(rng, genome, innovation);
+		return genome;
 	}
 
-	random = (float)rand() / (float)RAND_MAX;
+	random = nn_rng_float(rng);
 	if(random < config.genome_change_activation_probability){
-		neat_genome_mutate_activation(genome, innovation);
+		genome = neat_genome_make_writable(pool, genome);
+		neat_genome_mutate_activation(rng, genome, innovation);
 	}
 
-	random = (float)rand() / (float)RAND_MAX;
+	random = nn_rng_float(rng);
 	if(random < config.genome_weight_mutation_probability){
-		neat_genome_mutate_weight(genome, innovation);
+		genome = neat_genome_make_writable(pool, genome);
+		neat_genome_mutate_weight(rng, genome, innovation);
 	}
 
-	random = (float)rand() / (float)RAND_MAX;
+	random = nn_rng_float(rng);
 	if(random < config.genome_all_weights_mutation_probability){
-		neat_genome_mutate_all_weights(genome, innovation);
+		genome = neat_genome_make_writable(pool, genome);
+		neat_genome_mutate_all_weights(rng, genome, innovation);
 	}
+
+	return genome;
 }
 
-void neat_genome_destroy(struct neat_genome *genome)
+struct neat_genome *neat_genome_share(struct neat_genome *genome)
 {
 	assert(genome);
+	assert(genome->refs > 0);
+
+	genome->refs++;
+
+	return genome;
+}
+
+void neat_genome_destroy(struct neat_pool *pool, struct neat_genome *genome)
+{
+	size_t refs;
+
+	assert(pool);
+	assert(genome);
+
+	neat_pool_lock(pool);
+	assert(genome->refs > 0);
+	refs = --genome->refs;
+	neat_pool_unlock(pool);
+
+	if(refs > 0){
+		return;
+	}
+
+	neat_pool_free(pool, genome, genome->bytes);
+}
+
+struct neat_genome_batch{
+	struct neat_pool *pool;
+	const struct nn_rng *rng;
+	struct neat_genome **genomes;
+	const struct neat_config *config;
+	int innovation;
+};
+
+static void neat_genome_mutate_batch_item(void *data,
+					  size_t index,
+					  size_t worker)
+{
+	struct neat_genome_batch *batch;
+	struct nn_rng rng;
+
+	(void)worker;
+
+	batch = data;
+	assert(batch);
+
+	/* Every genome gets its own stream so the result doesn't depend on
+	 * the thread or the order
+	 */
+	rng = nn_rng_derive(batch->rng, index);
+
+	batch->genomes[index] = neat_genome_mutate(batch->pool,
+						   &rng,
+						   batch->genomes[index],
+						   *batch->config,
+						   batch->innovation);
+}
+
+void neat_genome_mutate_batch(struct neat_pool *pool,
+			      const struct nn_rng *rng,
+			      struct neat_genome **genomes,
+			      size_t count,
+			      struct neat_config config,
+			      int innovation,
+			      struct neat_parallel_pool *parallel,
+			      size_t threads)
+{
+	struct neat_genome_batch batch;
 
-	nn_ffnet_destroy(genome->net);
-	free(genome->innov_weight);
-	free(genome);
+	assert(pool);
+	assert(rng);
+	assert(genomes || count == 0);
+	assert(innovation > 0);
+
+	batch.pool = pool;
+	batch.rng = rng;
+	batch.genomes = genomes;
+	batch.config = &config;
+	batch.innovation = innovation;
+
+	neat_parallel_for(parallel,
+			  count,
+			  threads,
+			  neat_genome_mutate_batch_item,
+			  &batch);
 }
 
-const float *neat_genome_run(struct neat_genome *genome, const float *inputs)
+const float *neat_genome_run(const struct neat_genome *genome,
+			     const float *inputs,
+			     float *neurons)
 {
 	assert(genome);
 	assert(inputs);
+	assert(neurons);
+
+	return nn_ffnet_run_into(genome->net, inputs, neurons);
+}
+
+/* Kinds of encoded genomes, a delta only contains the differences with the
+ * parent it was created from
+ */
+#define NEAT_GENOME_ENCODE_FULL 0
+#define NEAT_GENOME_ENCODE_DELTA 1
+
+/* Read an index that's stored as the distance from the next index */
+static size_t neat_genome_read_index(struct neat_reader *r,
+				     size_t next,
+				     size_t count)
+{
+	uint64_t gap;
+
+	gap = neat_read_varint(r);
+	if(gap >= count - next){
+		r->error = true;
+		return next;
+	}
+
+	return next + (size_t)gap;
+}
+
+static int neat_genome_read_innovation(struct neat_reader *r)
+{
+	uint64_t innovation;
+
+	innovation = neat_read_varint(r);
+	if(innovation > INT_MAX){
+		r->error = true;
+		return 0;
+	}
+
+	return (int)innovation;
+}
+
+static bool neat_genome_same_shape(const struct nn_ffnet *n1,
+				   const struct nn_ffnet *n2)
+{
+	return n1->ninputs == n2->ninputs &&
+		n1->nhiddens == n2->nhiddens &&
+		n1->noutputs == n2->noutputs &&
+		n1->nhidden_layers == n2->nhidden_layers &&
+		memcmp(&n1->bias, &n2->bias, sizeof(n1->bias)) == 0;
+}
+
+static bool neat_genome_weight_changed(const struct neat_genome *genome,
+				       const struct neat_genome *parent,
+				       size_t i)
+{
+	return genome->innov_weight[i] != parent->innov_weight[i] ||
+		memcmp(genome->net->weight + i,
+		       parent->net->weight + i,
+		       sizeof(float)) != 0;
+}
+
+static bool neat_genome_activation_changed(const struct neat_genome *genome,
+					   const struct neat_genome *parent,
+					   size_t i)
+{
+	return genome->innov_activ[i] != parent->innov_activ[i] ||
+		genome->net->activation[i] != parent->net->activation[i];
+}
+
+static void neat_genome_encode_full(struct neat_writer *w,
+				    const struct neat_genome *genome)
+{
+	const struct nn_ffnet *n;
+	size_t i, next;
+
+	n = genome->net;
+
+	neat_write_float(w, n->bias);
+
+	for(i = 0; i < n->nactivations; i++){
+		neat_write_byte(w, (unsigned char)n->activation[i]);
+		neat_write_varint(w, (uint64_t)genome->innov_activ[i]);
+	}
+
+	/* Only the set weights are written */
+	neat_write_varint(w, genome->used_weights);
+	next = 0;
+	for(i = 0; i < n->nweights; i++){
+		if(n->weight[i] == 0.0f){
+			continue;
+		}
+
+		neat_write_varint(w, i - next);
+		neat_write_float(w, n->weight[i]);
+		neat_write_varint(w, (uint64_t)genome->innov_weight[i]);
+		next = i + 1;
+	}
+}
+
+static void neat_genome_encode_delta(struct neat_writer *w,
+				     const struct neat_genome *genome,
+				     const struct neat_genome *parent)
+{
+	const struct nn_ffnet *n;
+	size_t i, next, changed;
+
+	n = genome->net;
+
+	neat_write_fixed(w, parent->fingerprint, 8);
+
+	changed = 0;
+	for(i = 0; i < n->nactivations; i++){
+		changed += neat_genome_activation_changed(genome, parent, i);
+	}
+	neat_write_varint(w, changed);
+	next = 0;
+	for(i = 0; i < n->nactivations; i++){
+		if(!neat_genome_activation_changed(genome, parent, i)){
+			continue;
+		}
+
+		neat_write_varint(w, i - next);
+		neat_write_byte(w, (unsigned char)n->activation[i]);
+		neat_write_varint(w, (uint64_t)genome->innov_activ[i]);
+		next = i + 1;
+	}
+
+	changed = 0;
+	for(i = 0; i < n->nweights; i++){
+		changed += neat_genome_weight_changed(genome, parent, i);
+	}
+	neat_write_varint(w, changed);
+	next = 0;
+	for(i = 0; i < n->nweights; i++){
+		if(!neat_genome_weight_changed(genome, parent, i)){
+			continue;
+		}
+
+		neat_write_varint(w, i - next);
+		neat_write_float(w, n->weight[i]);
+		neat_write_varint(w, (uint64_t)genome->innov_weight[i]);
+		next = i + 1;
+	}
+}
 
-	return nn_ffnet_run(genome->net, inputs);
+size_t neat_genome_encode(const struct neat_genome *genome,
+			  const struct neat_genome *parent,
+			  void *buffer,
+			  size_t size)
+{
+	struct neat_writer w;
+	const struct nn_ffnet *n;
+	bool delta;
+
+	assert(genome);
+	assert(genome->net);
+	assert(buffer || size == 0);
+
+	w.buffer = buffer;
+	w.size = size;
+	w.pos = 0;
+	w.grow = false;
+
+	n = genome->net;
+
+	/* A delta is only possible when the parent has the same shape */
+	delta = parent && neat_genome_same_shape(n, parent->net);
+
+	neat_write_byte(&w, delta ? NEAT_GENOME_ENCODE_DELTA :
+			       NEAT_GENOME_ENCODE_FULL);
+	neat_write_fixed(&w, genome->fingerprint, 8);
+	neat_write_varint(&w, n->ninputs);
+	neat_write_varint(&w, n->nhiddens);
+	neat_write_varint(&w, n->noutputs);
+	neat_write_varint(&w, n->nhidden_layers);
+
+	if(delta){
+		neat_genome_encode_delta(&w, genome, parent);
+	}else{
+		neat_genome_encode_full(&w, genome);
+	}
+
+	return w.pos;
+}
+
+bool neat_genome_encoded_parent(const void *data,
+				size_t size,
+				uint64_t *fingerprint)
+{
+	struct neat_reader r;
+	size_t i;
+
+	assert(data || size == 0);
+	assert(fingerprint);
+
+	r.data = data;
+	r.size = size;
+	r.pos = 0;
+	r.error = false;
+
+	if(neat_read_byte(&r) != NEAT_GENOME_ENCODE_DELTA){
+		return false;
+	}
+
+	/* Skip the fingerprint of the genome itself and the shape */
+	neat_read_fixed(&r, 8);
+	for(i = 0; i < 4; i++){
+		neat_read_varint(&r);
+	}
+
+	*fingerprint = neat_read_fixed(&r, 8);
+
+	return !r.error;
+}
+
+static bool neat_genome_decode_full(struct neat_reader *r,
+				    struct neat_genome *genome)
+{
+	struct nn_ffnet *n;
+	size_t i, next, count, layer;
+
+	n = genome->net;
+
+	n->bias = neat_read_float(r);
+
+	for(i = 0; i < n->nactivations; i++){
+		unsigned char activation;
+
+		activation = neat_read_byte(r);
+		n->activation[i] = (char)activation;
+		genome->innov_activ[i] = neat_genome_read_innovation(r);
+		if(activation >= _NN_ACTIVATION_COUNT ||
+		   (activation != NN_ACTIVATION_PASSTHROUGH &&
+		    genome->innov_activ[i] == 0)){
+			return false;
+		}
+	}
+
+	count = (size_t)neat_read_varint(r);
+	if(count > n->nweights){
+		return false;
+	}
+	next = 0;
+	while(count-- > 0 && !r->error){
+		i = neat_genome_read_index(r, next, n->nweights);
+		if(r->error){
+			return false;
+		}
+		n->weight[i] = neat_read_float(r);
+		genome->innov_weight[i] = neat_genome_read_innovation(r);
+		if(n->weight[i] == 0.0f || genome->innov_weight[i] == 0){
+			return false;
+		}
+		next = i + 1;
+	}
+
+	for(layer = 0; layer <= n->nhidden_layers; layer++){
+		neat_genome_count_layer(genome, layer);
+	}
+	neat_genome_fingerprint(genome);
+
+	return true;
+}
+
+static bool neat_genome_decode_delta(struct neat_reader *r,
+				     struct neat_genome *genome)
+{
+	struct nn_ffnet *n;
+	size_t i, next, count;
+
+	n = genome->net;
+
+	/* The parent was already checked */
+	neat_read_fixed(r, 8);
+
+	count = (size_t)neat_read_varint(r);
+	if(count > n->nactivations){
+		return false;
+	}
+	next = 0;
+	while(count-- > 0 && !r->error){
+		unsigned char activation;
+		int innovation;
+
+		i = neat_genome_read_index(r, next, n->nactivations);
+		if(r->error){
+			return false;
+		}
+		activation = neat_read_byte(r);
+		innovation = neat_genome_read_innovation(r);
+		if(activation >= _NN_ACTIVATION_COUNT ||
+		   (activation != NN_ACTIVATION_PASSTHROUGH &&
+		    innovation == 0)){
+			return false;
+		}
+		neat_genome_set_activation(genome,
+					   i,
+					   (enum nn_activation)activation,
+					   innovation);
+		next = i + 1;
+	}
+
+	count = (size_t)neat_read_varint(r);
+	if(count > n->nweights){
+		return false;
+	}
+	next = 0;
+	while(count-- > 0 && !r->error){
+		float weight;
+		int innovation;
+
+		i = neat_genome_read_index(r, next, n->nweights);
+		if(r->error){
+			return false;
+		}
+		weight = neat_read_float(r);
+		innovation = neat_genome_read_innovation(r);
+		if(weight != 0.0f && innovation == 0){
+			return false;
+		}
+		neat_genome_set_weight(genome, i, weight, innovation);
+		next = i + 1;
+	}
+
+	return true;
+}
+
+struct neat_genome *neat_genome_decode(struct neat_pool *pool,
+				       struct neat_config config,
+				       const void *data,
+				       size_t size,
+				       const struct neat_genome *parent)
+{
+	struct neat_reader r;
+	struct neat_genome *genome;
+	uint64_t fingerprint, parent_fingerprint, shape[4];
+	unsigned char kind;
+	size_t i;
+	bool valid;
+
+	assert(pool);
+	assert(data || size == 0);
+
+	r.data = data;
+	r.size = size;
+	r.pos = 0;
+	r.error = false;
+
+	kind = neat_read_byte(&r);
+	fingerprint = neat_read_fixed(&r, 8);
+	for(i = 0; i < 4; i++){
+		shape[i] = neat_read_varint(&r);
+	}
+	/* The size of the block follows from the shape, so garbage must be
+	 * rejected before it's allocated
+	 */
+	if(r.error ||
+	   shape[0] != config.network_inputs ||
+	   shape[1] != config.network_hidden_nodes ||
+	   shape[2] != config.network_outputs){
+		return NULL;
+	}
+
+	if(kind == NEAT_GENOME_ENCODE_DELTA){
+		/* The changes are applied to a copy of the parent */
+		if(!neat_genome_encoded_parent(data, size, &parent_fingerprint) ||
+		   !parent || parent->fingerprint != parent_fingerprint ||
+		   shape[0] != parent->net->ninputs ||
+		   shape[1] != parent->net->nhiddens ||
+		   shape[2] != parent->net->noutputs ||
+		   shape[3] != parent->net->nhidden_layers){
+			return NULL;
+		}
+
+		genome = neat_genome_copy(pool, parent);
+		valid = neat_genome_decode_delta(&r, genome);
+	}else if(kind == NEAT_GENOME_ENCODE_FULL){
+		/* Every activation takes at least 2 bytes, which limits the
+		 * amount of hidden layers
+		 */
+		if(shape[1] == 0 || shape[2] == 0 || shape[2] > size ||
+		   shape[3] > size / 2 / shape[1] ||
+		   (shape[1] * shape[3] + shape[2]) * 2 > size){
+			return NULL;
+		}
+
+		genome = neat_genome_allocate(pool,
+					      (size_t)shape[0],
+					      (size_t)shape[1],
+					      (size_t)shape[2],
+					      (size_t)shape[3]);
+		valid = neat_genome_decode_full(&r, genome);
+	}else{
+		return NULL;
+	}
+
+	/* The fingerprint catches corrupted weights */
+	if(!valid || r.error || r.pos != size ||
+	   genome->fingerprint != fingerprint){
+		neat_genome_destroy(pool, genome);
+		return NULL;
+	}
+
+	return genome;
 }
 
 bool neat_genome_is_compatible(const struct neat_genome *genome,
@@ -464,7 +1416,7 @@ bool neat_genome_is_compatible(const struct neat_genome *genome,
 			       float treshold,
 			       size_t total_species)
 {
-	size_t i, excess, disjoint, matching;
+	size_t excess, disjoint, matching;
 	size_t weights1, weights2, min_weights, max_weights;
 	float weight_sum, distance;
 
@@ -489,23 +1441,15 @@ bool neat_genome_is_compatible(const struct neat_genome *genome,
 	 * smallest genome
 	 */
 	excess = max_weights - min_weights;
-	disjoint = 0;
+	matching = neat_kernel_matching_difference(genome->net->weight,
+						   other->net->weight,
+						   genome->innov_weight,
+						   other->innov_weight,
+						   min_weights,
+						   &weight_sum);
+	disjoint = min_weights - matching;
 	/* Always add an extra one so we don't get a divide by zero */
-	matching = 1;
-	weight_sum = 0.0;
-
-	for(i = 0; i < min_weights; i++){
-		if(genome->innov_weight[i] == other->innov_weight[i]){
-			float weight1, weight2;
-
-			weight1 = genome->net->weight[i];
-			weight2 = other->net->weight[i];
-			weight_sum += fabs(weight1 - weight2);
-			matching++;
-		}else{
-			disjoint++;
-		}
-	}
+	matching++;
 
 	distance = 1.0f * excess / (float)max_weights;
 	distance += 1.5f * disjoint / (float)max_weights;
@@ -4,29 +4,136 @@
 #include <nn.h>
 
 #include "species.h"
+#include "pool.h"
+#include "parallel.h"
 
 struct neat_genome{
 	struct nn_ffnet *net;
 	int *innov_weight, *innov_activ;
 	size_t ninnov_weights, ninnov_activs;
+	/* Amount of weights that aren't 0 and activations that aren't
+	 * passthrough, their innovations are 0 exactly when they're unused
+	 */
 	size_t used_weights, used_activs;
+	/* The same counts per layer, there are nhidden_layers + 1 layers where
+	 * the last one is the output layer, the weights of a layer are the
+	 * ones going into it
+	 */
+	size_t *layer_weights, *layer_activs;
 
-	float fitness;
-	size_t time_alive;
+	/* Hash of the shape, the weights and the activations, genomes with the
+	 * same network have the same fingerprint
+	 */
+	uint64_t fingerprint;
+
+	/* Size of the block containing the genome, the network and the
+	 * innovations
+	 */
+	size_t bytes;
+
+	/* Amount of organisms sharing this genome, it's copied when one of
+	 * them writes to it
+	 */
+	size_t refs;
 };
 
-struct neat_genome *neat_genome_create(struct neat_config config,
+/* All the genomes are allocated as a single block from the pool */
+struct neat_genome *neat_genome_create(struct neat_pool *pool,
+				       struct nn_rng *rng,
+				       struct neat_config config,
 				       int innovation);
-struct neat_genome *neat_genome_copy(const struct neat_genome *genome);
-struct neat_genome *neat_genome_reproduce(const struct neat_genome *parent1,
+struct neat_genome *neat_genome_copy(struct neat_pool *pool,
+				     const struct neat_genome *genome);
+/* Share the genome without copying it, the returned pointer is the same but
+ * it's only copied when it gets mutated
+ */
+struct neat_genome *neat_genome_share(struct neat_genome *genome);
+/* Create a child genome from two parents
+ * dest		genome that's replaced by the child, its block is reused when
+ *		it isn't shared and has the same shape, the reference is always
+ *		released, can be NULL
+ * parent1	the fittest parent, it's used as the base for the child
+ */
+struct neat_genome *neat_genome_reproduce(struct neat_pool *pool,
+					  struct neat_genome *dest,
+					  const struct neat_genome *parent1,
 					  const struct neat_genome *parent2);
-void neat_genome_destroy(struct neat_genome *genome);
+/* Release a reference to the genome, the block is returned to the pool when
+ * it was the last one
+ */
+void neat_genome_destroy(struct neat_pool *pool, struct neat_genome *genome);
+
+/* Run the network with its neurons in the memory, it's never written to the
+ * genome so genomes shared by multiple organisms can be run for each of them
+ * neurons	at least net->nneurons floats
+ */
+const float *neat_genome_run(const struct neat_genome *genome,
+			     const float *inputs,
+			     float *neurons);
+
+/* Mutate the genome, adding a neuron can create a new layer which doesn't fit
+ * in the block anymore and a shared genome is copied before it's changed
+ *
+ * return a new pointer because the genome can be moved to another block, you
+ * should overwrite the pointer you were using with this, example:
+ * genome = neat_genome_mutate(pool, rng, genome, config, innovation);
+ */
+struct neat_genome *neat_genome_mutate(struct neat_pool *pool,
+				       struct nn_rng *rng,
+				       struct neat_genome *genome,
+				       struct neat_config config,
+				       int innovation);
 
-const float *neat_genome_run(struct neat_genome *genome, const float *inputs);
+/* Mutate multiple genomes at the same time spread over multiple threads, the
+ * pointers in the array are overwritten like with neat_genome_mutate
+ * rng		genome n is mutated with the stream derived with n from this
+ *		generator, so the results are the same for every amount of
+ *		threads
+ * threads	amount of threads of the parallel pool to use, 0 or 1 mutates
+ *		them on the calling thread
+ */
+void neat_genome_mutate_batch(struct neat_pool *pool,
+			      const struct nn_rng *rng,
+			      struct neat_genome **genomes,
+			      size_t count,
+			      struct neat_config config,
+			      int innovation,
+			      struct neat_parallel_pool *parallel,
+			      size_t threads);
 
-void neat_genome_mutate(struct neat_genome *genome,
-			struct neat_config config,
-			int innovation);
+/* Encode the genome in a compact binary form, only the set weights are stored
+ * parent	when it's not NULL and has the same shape only the differences
+ *		with it are stored, the decoder needs the same parent
+ * buffer	where the data is written to, nothing is written past size
+ *
+ * return the size of the encoded genome, when it's bigger than size the
+ * buffer was too small and the data is incomplete
+ */
+size_t neat_genome_encode(const struct neat_genome *genome,
+			  const struct neat_genome *parent,
+			  void *buffer,
+			  size_t size);
+/* Get the fingerprint of the parent a delta was encoded against
+ *
+ * return false if the data isn't a delta
+ */
+bool neat_genome_encoded_parent(const void *data,
+				size_t size,
+				uint64_t *fingerprint);
+/* Create a genome from encoded data
+ * config	the inputs, hidden nodes and outputs of the genome must match
+ *		it, this is checked before anything is allocated
+ * parent	the parent the delta was encoded against, ignored for full
+ *		encodings
+ *
+ * return NULL if the data is invalid, has another shape or the parent doesn't
+ * match
+ */
+struct neat_genome *neat_genome_decode(struct neat_pool *pool,
+				       struct neat_config config,
+				       const void *data,
+				       size_t size,
+				       const struct neat_genome *parent);
 
 bool neat_genome_is_compatible(const struct neat_genome *genome,
 			       const struct neat_genome *other,
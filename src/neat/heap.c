@@ -0,0 +1,157 @@
+#include "heap.h"
+
+#include <stdint.h>
+#include <assert.h>
+
+/* Amount of items a heap has room for when the first one is added */
+#define NEAT_HEAP_MINIMUM_SIZE 4
+
+static void neat_heap_resize(struct neat_heap *heap, size_t size)
+{
+	assert(heap);
+	assert(size >= heap->nitems);
+
+	heap->items = realloc(heap->items, sizeof(size_t) * size);
+	assert(heap->items);
+	heap->size = size;
+}
+
+static void neat_heap_set(struct neat_heap *heap, size_t index, size_t item)
+{
+	heap->items[index] = item;
+	heap->moved(heap->data, item, index);
+}
+
+static void neat_heap_up(struct neat_heap *heap, size_t index)
+{
+	size_t item;
+
+	item = heap->items[index];
+	while(index > 0){
+		size_t parent;
+
+		parent = (index - 1) / 2;
+		if(!heap->before(heap->data, item, heap->items[parent])){
+			break;
+		}
+
+		neat_heap_set(heap, index, heap->items[parent]);
+		index = parent;
+	}
+	neat_heap_set(heap, index, item);
+}
+
+/* return the new index of the item */
+static size_t neat_heap_down(struct neat_heap *heap, size_t index)
+{
+	size_t item;
+
+	item = heap->items[index];
+	for(;;){
+		size_t child;
+
+		child = index * 2 + 1;
+		if(child >= heap->nitems){
+			break;
+		}
+		if(child + 1 < heap->nitems &&
+		   heap->before(heap->data,
+				heap->items[child + 1],
+				heap->items[child])){
+			child++;
+		}
+		if(!heap->before(heap->data, heap->items[child], item)){
+			break;
+		}
+
+		neat_heap_set(heap, index, heap->items[child]);
+		index = child;
+	}
+	neat_heap_set(heap, index, item);
+
+	return index;
+}
+
+void neat_heap_init(struct neat_heap *heap,
+		    neat_heap_before before,
+		    neat_heap_moved moved,
+		    void *data)
+{
+	assert(heap);
+	assert(before);
+	assert(moved);
+
+	heap->items = NULL;
+	heap->nitems = heap->size = 0;
+	heap->before = before;
+	heap->moved = moved;
+	heap->data = data;
+}
+
+void neat_heap_clear(struct neat_heap *heap)
+{
+	assert(heap);
+
+	free(heap->items);
+	heap->items = NULL;
+	heap->nitems = heap->size = 0;
+}
+
+void neat_heap_push(struct neat_heap *heap, size_t item)
+{
+	assert(heap);
+
+	/* Double the size so pushing is amortized constant time */
+	if(heap->nitems == heap->size){
+		neat_heap_resize(heap, heap->size > 0 ?
+				 heap->size * 2 : NEAT_HEAP_MINIMUM_SIZE);
+	}
+
+	heap->items[heap->nitems++] = item;
+	neat_heap_up(heap, heap->nitems - 1);
+}
+
+void neat_heap_remove(struct neat_heap *heap, size_t index)
+{
+	size_t last;
+
+	assert(heap);
+	assert(index < heap->nitems);
+
+	heap->moved(heap->data, heap->items[index], SIZE_MAX);
+
+	/* Put the last item in the hole and move it to the right place */
+	last = --heap->nitems;
+	if(index != last){
+		heap->items[index] = heap->items[last];
+		neat_heap_fix(heap, index);
+	}
+
+	/* Halve the size when it's mostly empty, not at the half so pushing
+	 * and removing around it doesn't resize every time
+	 */
+	if(heap->size > NEAT_HEAP_MINIMUM_SIZE &&
+	   heap->nitems <= heap->size / 4){
+		neat_heap_resize(heap, heap->size / 2);
+	}
+}
+
+void neat_heap_fix(struct neat_heap *heap, size_t index)
+{
+	assert(heap);
+	assert(index < heap->nitems);
+
+	index = neat_heap_down(heap, index);
+	neat_heap_up(heap, index);
+}
+
+void neat_heap_build(struct neat_heap *heap)
+{
+	size_t i;
+
+	assert(heap);
+
+	for(i = heap->nitems / 2; i > 0; i--){
+		neat_heap_down(heap, i - 1);
+	}
+}
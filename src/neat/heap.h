@@ -0,0 +1,37 @@
+#pragma once
+
+#include <stdlib.h>
+#include <stdbool.h>
+
+/* Return true if item1 should be closer to the top than item2 */
+typedef bool (*neat_heap_before)(const void *data, size_t item1, size_t item2);
+/* Called every time an item is placed at another index so the position can
+ * be stored, SIZE_MAX when it's removed
+ */
+typedef void (*neat_heap_moved)(void *data, size_t item, size_t index);
+
+/* Binary heap of ids where the position of every item is reported back so it
+ * can be updated or removed in logarithmic time
+ */
+struct neat_heap{
+	size_t *items;
+	size_t nitems, size;
+
+	neat_heap_before before;
+	neat_heap_moved moved;
+	void *data;
+};
+
+void neat_heap_init(struct neat_heap *heap,
+		    neat_heap_before before,
+		    neat_heap_moved moved,
+		    void *data);
+void neat_heap_clear(struct neat_heap *heap);
+
+void neat_heap_push(struct neat_heap *heap, size_t item);
+/* Remove the item at the index */
+void neat_heap_remove(struct neat_heap *heap, size_t index);
+/* Move the item at the index to the right place after its order changed */
+void neat_heap_fix(struct neat_heap *heap, size_t index);
+/* Order all the items again after most of them changed */
+void neat_heap_build(struct neat_heap *heap);
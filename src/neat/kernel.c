@@ -0,0 +1,242 @@
+#include "kernel.h"
+
+#include <math.h>
+#include <assert.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+
+/* Amount of set bits in a 4 bit mask */
+static const unsigned char neat_kernel_bits[16] = {
+	0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4
+};
+#endif
+
+/* Amount of floats or ints in a vector */
+#define NEAT_KERNEL_WIDTH 4
+
+size_t neat_kernel_mask_innovations(int *innov,
+				    const float *weight,
+				    size_t count)
+{
+	size_t i, used;
+
+	assert(innov || count == 0);
+	assert(weight || count == 0);
+
+	i = used = 0;
+#ifdef __SSE2__
+	for(; i + NEAT_KERNEL_WIDTH <= count; i += NEAT_KERNEL_WIDTH){
+		__m128 is_set;
+		__m128i in;
+
+		is_set = _mm_cmpneq_ps(_mm_loadu_ps(weight + i),
+				       _mm_setzero_ps());
+		in = _mm_loadu_si128((const __m128i*)(innov + i));
+		in = _mm_and_si128(in, _mm_castps_si128(is_set));
+		_mm_storeu_si128((__m128i*)(innov + i), in);
+
+		used += neat_kernel_bits[_mm_movemask_ps(is_set)];
+	}
+#endif
+	for(; i < count; i++){
+		int is_set;
+
+		is_set = weight[i] != 0.0f;
+		innov[i] *= is_set;
+		used += is_set;
+	}
+
+	return used;
+}
+
+size_t neat_kernel_set_innovations(int *innov,
+				   const float *weight,
+				   size_t count,
+				   int innovation)
+{
+	size_t i, used;
+
+	assert(innov || count == 0);
+	assert(weight || count == 0);
+
+	i = used = 0;
+#ifdef __SSE2__
+	{
+		__m128i in;
+
+		in = _mm_set1_epi32(innovation);
+		for(; i + NEAT_KERNEL_WIDTH <= count; i += NEAT_KERNEL_WIDTH){
+			__m128 is_set;
+
+			is_set = _mm_cmpneq_ps(_mm_loadu_ps(weight + i),
+					       _mm_setzero_ps());
+			_mm_storeu_si128((__m128i*)(innov + i),
+					 _mm_and_si128(in,
+						       _mm_castps_si128(is_set)));
+
+			used += neat_kernel_bits[_mm_movemask_ps(is_set)];
+		}
+	}
+#endif
+	for(; i < count; i++){
+		int is_set;
+
+		is_set = weight[i] != 0.0f;
+		innov[i] = innovation * is_set;
+		used += is_set;
+	}
+
+	return used;
+}
+
+size_t neat_kernel_blend_matching(float *child,
+				  int *child_innov,
+				  const float *weight1,
+				  const float *weight2,
+				  const int *innov1,
+				  const int *innov2,
+				  size_t count)
+{
+	size_t i, lost;
+
+	assert(child || count == 0);
+	assert(child_innov || count == 0);
+	assert(weight1 || count == 0);
+	assert(weight2 || count == 0);
+	assert(innov1 || count == 0);
+	assert(innov2 || count == 0);
+
+	i = 0;
+	lost = 0;
+#ifdef __SSE2__
+	{
+		__m128 half, zero;
+		__m128i izero;
+
+		half = _mm_set1_ps(0.5f);
+		zero = _mm_setzero_ps();
+		izero = _mm_setzero_si128();
+		for(; i + NEAT_KERNEL_WIDTH <= count; i += NEAT_KERNEL_WIDTH){
+			__m128 matching, average, old, unset;
+			__m128i in1, in2, set, innov;
+			int mask;
+
+			in1 = _mm_loadu_si128((const __m128i*)(innov1 + i));
+			in2 = _mm_loadu_si128((const __m128i*)(innov2 + i));
+			matching = _mm_castsi128_ps(_mm_cmpeq_epi32(in1, in2));
+
+			average = _mm_add_ps(_mm_loadu_ps(weight1 + i),
+					     _mm_loadu_ps(weight2 + i));
+			average = _mm_mul_ps(average, half);
+
+			old = _mm_loadu_ps(child + i);
+			_mm_storeu_ps(child + i,
+				      _mm_or_ps(_mm_and_ps(matching, average),
+						_mm_andnot_ps(matching, old)));
+
+			/* The weight is lost when two set weights cancel out */
+			set = _mm_xor_si128(_mm_cmpeq_epi32(in1, izero),
+					    _mm_set1_epi32(-1));
+			unset = _mm_and_ps(_mm_and_ps(matching,
+						      _mm_cmpeq_ps(average, zero)),
+					   _mm_castsi128_ps(set));
+
+			innov = _mm_loadu_si128((__m128i*)(child_innov + i));
+			innov = _mm_andnot_si128(_mm_castps_si128(unset), innov);
+			_mm_storeu_si128((__m128i*)(child_innov + i), innov);
+
+			mask = _mm_movemask_ps(unset);
+			lost += (mask & 1) + (mask >> 1 & 1) +
+				(mask >> 2 & 1) + (mask >> 3 & 1);
+		}
+	}
+#endif
+	for(; i < count; i++){
+		if(innov1[i] == innov2[i]){
+			/* Dividing by two is exact so it's the same as the
+			 * multiplication by a half
+			 */
+			child[i] = (weight1[i] + weight2[i]) * 0.5f;
+			if(innov1[i] != 0 && child[i] == 0.0f){
+				child_innov[i] = 0;
+				lost++;
+			}
+		}
+	}
+
+	return lost;
+}
+
+size_t neat_kernel_matching_difference(const float *weight1,
+				       const float *weight2,
+				       const int *innov1,
+				       const int *innov2,
+				       size_t count,
+				       float *weight_sum)
+{
+	float sums[NEAT_KERNEL_WIDTH];
+	size_t i, j, matching;
+
+	assert(weight1 || count == 0);
+	assert(weight2 || count == 0);
+	assert(innov1 || count == 0);
+	assert(innov2 || count == 0);
+	assert(weight_sum);
+
+	/* The sums are kept per lane so the scalar version adds the floats
+	 * in the same order as the vectorized one
+	 */
+	for(j = 0; j < NEAT_KERNEL_WIDTH; j++){
+		sums[j] = 0.0f;
+	}
+
+	i = matching = 0;
+#ifdef __SSE2__
+	{
+		__m128 sum, sign;
+
+		sum = _mm_setzero_ps();
+		sign = _mm_set1_ps(-0.0f);
+		for(; i + NEAT_KERNEL_WIDTH <= count; i += NEAT_KERNEL_WIDTH){
+			__m128 is_matching, difference;
+			__m128i in1, in2;
+
+			in1 = _mm_loadu_si128((const __m128i*)(innov1 + i));
+			in2 = _mm_loadu_si128((const __m128i*)(innov2 + i));
+			is_matching = _mm_castsi128_ps(_mm_cmpeq_epi32(in1,
+								       in2));
+
+			difference = _mm_sub_ps(_mm_loadu_ps(weight1 + i),
+						_mm_loadu_ps(weight2 + i));
+			difference = _mm_andnot_ps(sign, difference);
+
+			sum = _mm_add_ps(sum,
+					 _mm_and_ps(is_matching, difference));
+			matching += neat_kernel_bits[
+				_mm_movemask_ps(is_matching)];
+		}
+		_mm_storeu_ps(sums, sum);
+	}
+#else
+	for(; i + NEAT_KERNEL_WIDTH <= count; i += NEAT_KERNEL_WIDTH){
+		for(j = 0; j < NEAT_KERNEL_WIDTH; j++){
+			if(innov1[i + j] == innov2[i + j]){
+				sums[j] += fabs(weight1[i + j] -
+						weight2[i + j]);
+				matching++;
+			}
+		}
+	}
+#endif
+	for(j = 0; i < count; i++, j++){
+		if(innov1[i] == innov2[i]){
+			sums[j] += fabs(weight1[i] - weight2[i]);
+			matching++;
+		}
+	}
+
+	*weight_sum = (sums[0] + sums[1]) + (sums[2] + sums[3]);
+
+	return matching;
+}
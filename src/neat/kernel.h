@@ -0,0 +1,52 @@
+#pragma once
+
+#include <stdlib.h>
+
+/* Loops over the weights & innovations of genomes, they use SSE2 when it's
+ * available and fall back to scalar code otherwise, both give exactly the
+ * same results
+ */
+
+/* Set the innovations to 0 where the weight is 0
+ *
+ * return the amount of weights that are set
+ */
+size_t neat_kernel_mask_innovations(int *innov,
+				    const float *weight,
+				    size_t count);
+
+/* Set the innovations to the innovation where the weight is set and to 0
+ * where it's not
+ *
+ * return the amount of weights that are set
+ */
+size_t neat_kernel_set_innovations(int *innov,
+				   const float *weight,
+				   size_t count,
+				   int innovation);
+
+/* Set the child weight to the average of both the parent weights where the
+ * innovations match, the other weights are kept, the child innovation is
+ * cleared where the average of two set weights is 0
+ *
+ * return the amount of weights that became unset
+ */
+size_t neat_kernel_blend_matching(float *child,
+				  int *child_innov,
+				  const float *weight1,
+				  const float *weight2,
+				  const int *innov1,
+				  const int *innov2,
+				  size_t count);
+
+/* Sum the absolute differences of the weights where the innovations match
+ * weight_sum	the resulting sum
+ *
+ * return the amount of matching innovations
+ */
+size_t neat_kernel_matching_difference(const float *weight1,
+				       const float *weight2,
+				       const int *innov1,
+				       const int *innov2,
+				       size_t count,
+				       float *weight_sum);
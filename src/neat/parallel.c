@@ -0,0 +1,293 @@
+#include "parallel.h"
+
+#include <assert.h>
+
+/* Amount of indices a thread takes at once from its own range */
+#define NEAT_PARALLEL_CHUNK 4
+
+struct neat_parallel_job{
+	struct neat_parallel_range *ranges;
+	size_t nworkers;
+
+	neat_parallel_func func;
+	void *data;
+};
+
+/* Thread of the pool, its index is its worker index in the loops */
+struct neat_parallel_thread{
+	pthread_t handle;
+	struct neat_parallel_pool *pool;
+	size_t index;
+	/* Amount of loops the thread has seen */
+	unsigned long njobs;
+};
+
+/* Take the next chunk of the own range
+ *
+ * return false if the range is empty
+ */
+static bool neat_parallel_take(struct neat_parallel_range *range,
+			      size_t *start,
+			      size_t *end)
+{
+	pthread_mutex_lock(&range->lock);
+	*start = range->start;
+	*end = *start + NEAT_PARALLEL_CHUNK;
+	if(*end > range->end){
+		*end = range->end;
+	}
+	range->start = *end;
+	pthread_mutex_unlock(&range->lock);
+
+	return *start < *end;
+}
+
+/* Move the second half of the remaining indices of another thread to the own
+ * range
+ *
+ * return false if all the other threads are out of work
+ */
+static bool neat_parallel_steal(struct neat_parallel_job *job, size_t worker)
+{
+	size_t i;
+
+	for(i = 1; i < job->nworkers; i++){
+		struct neat_parallel_range *victim, *own;
+		size_t start, end;
+
+		victim = job->ranges + (worker + i) % job->nworkers;
+
+		pthread_mutex_lock(&victim->lock);
+		end = victim->end;
+		start = end - (end - victim->start + 1) / 2;
+		victim->end = start;
+		pthread_mutex_unlock(&victim->lock);
+
+		if(start >= end){
+			continue;
+		}
+
+		own = job->ranges + worker;
+		pthread_mutex_lock(&own->lock);
+		own->start = start;
+		own->end = end;
+		pthread_mutex_unlock(&own->lock);
+
+		return true;
+	}
+
+	return false;
+}
+
+/* Process indices until all the ranges are empty */
+static void neat_parallel_work(struct neat_parallel_job *job, size_t worker)
+{
+	for(;;){
+		size_t start, end;
+
+		if(!neat_parallel_take(job->ranges + worker, &start, &end)){
+			if(!neat_parallel_steal(job, worker)){
+				return;
+			}
+			continue;
+		}
+
+		for(; start < end; start++){
+			job->func(job->data, start, worker);
+		}
+	}
+}
+
+static void *neat_parallel_thread_main(void *arg)
+{
+	struct neat_parallel_thread *thread;
+	struct neat_parallel_pool *pool;
+
+	thread = arg;
+	assert(thread);
+	pool = thread->pool;
+
+	pthread_mutex_lock(&pool->lock);
+	for(;;){
+		struct neat_parallel_job *job;
+
+		while(!pool->stop && pool->njobs == thread->njobs){
+			pthread_cond_wait(&pool->wake, &pool->lock);
+		}
+		if(pool->stop){
+			break;
+		}
+		thread->njobs = pool->njobs;
+		job = pool->job;
+		pthread_mutex_unlock(&pool->lock);
+
+		/* Loops with fewer threads leave the rest of the pool idle */
+		if(thread->index < job->nworkers){
+			neat_parallel_work(job, thread->index);
+		}
+
+		pthread_mutex_lock(&pool->lock);
+		if(--pool->busy == 0){
+			pthread_cond_signal(&pool->done);
+		}
+	}
+	pthread_mutex_unlock(&pool->lock);
+
+	return NULL;
+}
+
+/* Make sure there are ranges for the amount of workers and start threads
+ * until there are that many, it's only called between loops
+ */
+static void neat_parallel_pool_grow(struct neat_parallel_pool *pool,
+				    size_t workers)
+{
+	size_t i;
+
+	assert(pool);
+
+	/* The locks can't be moved so they're created again */
+	if(pool->nranges < workers){
+		for(i = 0; i < pool->nranges; i++){
+			pthread_mutex_destroy(&pool->ranges[i].lock);
+		}
+		pool->ranges = realloc(pool->ranges,
+				       sizeof(struct neat_parallel_range) *
+				       workers);
+		assert(pool->ranges);
+		pool->nranges = workers;
+		for(i = 0; i < pool->nranges; i++){
+			pthread_mutex_init(&pool->ranges[i].lock, NULL);
+		}
+	}
+
+	if(pool->nthreads + 1 >= workers){
+		return;
+	}
+
+	pool->threads = realloc(pool->threads,
+				sizeof(struct neat_parallel_thread*) *
+				(workers - 1));
+	assert(pool->threads);
+
+	/* If a thread can't be created its part is stolen by the threads that
+	 * did start
+	 */
+	while(pool->nthreads + 1 < workers){
+		struct neat_parallel_thread *thread;
+
+		thread = malloc(sizeof(struct neat_parallel_thread));
+		assert(thread);
+		thread->pool = pool;
+		thread->index = pool->nthreads + 1;
+		thread->njobs = pool->njobs;
+		if(pthread_create(&thread->handle,
+				  NULL,
+				  neat_parallel_thread_main,
+				  thread) != 0){
+			free(thread);
+			break;
+		}
+		pool->threads[pool->nthreads++] = thread;
+	}
+}
+
+void neat_parallel_pool_init(struct neat_parallel_pool *pool)
+{
+	assert(pool);
+
+	pool->threads = NULL;
+	pool->nthreads = 0;
+	pool->ranges = NULL;
+	pool->nranges = 0;
+	pthread_mutex_init(&pool->lock, NULL);
+	pthread_cond_init(&pool->wake, NULL);
+	pthread_cond_init(&pool->done, NULL);
+	pool->job = NULL;
+	pool->njobs = 0;
+	pool->busy = 0;
+	pool->stop = false;
+}
+
+void neat_parallel_pool_clear(struct neat_parallel_pool *pool)
+{
+	size_t i;
+
+	assert(pool);
+
+	pthread_mutex_lock(&pool->lock);
+	pool->stop = true;
+	pthread_cond_broadcast(&pool->wake);
+	pthread_mutex_unlock(&pool->lock);
+
+	for(i = 0; i < pool->nthreads; i++){
+		pthread_join(pool->threads[i]->handle, NULL);
+		free(pool->threads[i]);
+	}
+	free(pool->threads);
+
+	for(i = 0; i < pool->nranges; i++){
+		pthread_mutex_destroy(&pool->ranges[i].lock);
+	}
+	free(pool->ranges);
+
+	pthread_cond_destroy(&pool->done);
+	pthread_cond_destroy(&pool->wake);
+	pthread_mutex_destroy(&pool->lock);
+}
+
+void neat_parallel_for(struct neat_parallel_pool *pool,
+		       size_t count,
+		       size_t threads,
+		       neat_parallel_func func,
+		       void *data)
+{
+	struct neat_parallel_job job;
+	size_t i;
+
+	assert(pool);
+	assert(func);
+
+	if(threads > count){
+		threads = count;
+	}
+
+	if(threads <= 1){
+		for(i = 0; i < count; i++){
+			func(data, i, 0);
+		}
+		return;
+	}
+
+	neat_parallel_pool_grow(pool, threads);
+
+	job.nworkers = threads;
+	job.func = func;
+	job.data = data;
+	job.ranges = pool->ranges;
+
+	/* Give every thread an equal part to start with */
+	for(i = 0; i < threads; i++){
+		job.ranges[i].start = count * i / threads;
+		job.ranges[i].end = count * (i + 1) / threads;
+	}
+
+	/* Wake the whole pool, the threads that aren't needed go back to
+	 * sleep
+	 */
+	pthread_mutex_lock(&pool->lock);
+	pool->job = &job;
+	pool->njobs++;
+	pool->busy = pool->nthreads;
+	pthread_cond_broadcast(&pool->wake);
+	pthread_mutex_unlock(&pool->lock);
+
+	neat_parallel_work(&job, 0);
+
+	pthread_mutex_lock(&pool->lock);
+	while(pool->busy > 0){
+		pthread_cond_wait(&pool->done, &pool->lock);
+	}
+	pool->job = NULL;
+	pthread_mutex_unlock(&pool->lock);
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <stdlib.h>
+#include <stdbool.h>
+#include <pthread.h>
+
+/* Function that's called for every index of a parallel loop
+ * worker	index of the thread that calls it, in [0, threads), it can be
+ *		used to give every thread its own scratch memory
+ */
+typedef void (*neat_parallel_func)(void *data, size_t index, size_t worker);
+
+/* Indices that still have to be processed by a thread, the owner takes them
+ * from the start and other threads steal from the end
+ */
+struct neat_parallel_range{
+	pthread_mutex_t lock;
+	size_t start, end;
+};
+
+/* Threads that are kept alive between the parallel loops so a loop doesn't
+ * pay for starting them, they sleep until the next loop is handed to them
+ */
+struct neat_parallel_pool{
+	/* The threads besides the calling one, they're only started when a
+	 * loop needs them
+	 */
+	struct neat_parallel_thread **threads;
+	size_t nthreads;
+
+	/* The range of every thread, the calling thread has the first one */
+	struct neat_parallel_range *ranges;
+	size_t nranges;
+
+	pthread_mutex_t lock;
+	pthread_cond_t wake, done;
+	/* The loop that's running, the threads recognize a new one by the
+	 * amount of loops
+	 */
+	struct neat_parallel_job *job;
+	unsigned long njobs;
+	/* Threads that didn't finish the loop yet */
+	size_t busy;
+	bool stop;
+};
+
+void neat_parallel_pool_init(struct neat_parallel_pool *pool);
+/* Stop and join all the threads */
+void neat_parallel_pool_clear(struct neat_parallel_pool *pool);
+
+/* Call the function for all the indices in [0, count) spread over multiple
+ * threads of the pool, the calling thread is one of them, the order in which
+ * the indices are processed is not defined so the function must not depend on
+ * it
+ *
+ * Every thread starts with an equal part of the indices and steals half of the
+ * remaining part of another thread when it's done, so the threads stay busy
+ * when some indices take much longer than others
+ * threads	amount of threads to use, 0 or 1 runs everything on the
+ *		calling thread, the pool starts the missing ones
+ */
+void neat_parallel_for(struct neat_parallel_pool *pool,
+		       size_t count,
+		       size_t threads,
+		       neat_parallel_func func,
+		       void *data);
@@ -0,0 +1,105 @@
+#include "pool.h"
+
+#include <string.h>
+#include <assert.h>
+
+static size_t neat_pool_class(size_t bytes)
+{
+	size_t class;
+
+	assert(bytes > 0);
+
+	/* Find the smallest power of two that fits the bytes */
+	class = 0;
+	while(((size_t)1 << class) < bytes){
+		class++;
+	}
+	assert(class < NEAT_POOL_CLASSES);
+
+	return class;
+}
+
+void neat_pool_init(struct neat_pool *pool)
+{
+	assert(pool);
+
+	memset(pool, 0, sizeof(struct neat_pool));
+	pthread_mutex_init(&pool->lock, NULL);
+}
+
+void neat_pool_clear(struct neat_pool *pool)
+{
+	size_t i;
+
+	assert(pool);
+
+	for(i = 0; i < NEAT_POOL_CLASSES; i++){
+		while(pool->free[i]){
+			void *next;
+
+			next = *(void**)pool->free[i];
+			free(pool->free[i]);
+			pool->free[i] = next;
+		}
+	}
+
+	pthread_mutex_destroy(&pool->lock);
+}
+
+void neat_pool_lock(struct neat_pool *pool)
+{
+	assert(pool);
+
+	pthread_mutex_lock(&pool->lock);
+}
+
+void neat_pool_unlock(struct neat_pool *pool)
+{
+	assert(pool);
+
+	pthread_mutex_unlock(&pool->lock);
+}
+
+void *neat_pool_alloc(struct neat_pool *pool, size_t bytes)
+{
+	size_t class;
+	void *block;
+
+	assert(pool);
+	assert(bytes >= sizeof(void*));
+
+	class = neat_pool_class(bytes);
+
+	/* Take the last freed block of this class if there is one */
+	pthread_mutex_lock(&pool->lock);
+	block = pool->free[class];
+	if(block){
+		pool->free[class] = *(void**)block;
+	}
+	pthread_mutex_unlock(&pool->lock);
+
+	if(block){
+		return block;
+	}
+
+	block = malloc((size_t)1 << class);
+	assert(block);
+
+	return block;
+}
+
+void neat_pool_free(struct neat_pool *pool, void *block, size_t bytes)
+{
+	size_t class;
+
+	assert(pool);
+	assert(block);
+
+	class = neat_pool_class(bytes);
+
+	/* Push the block on the front of the list */
+	pthread_mutex_lock(&pool->lock);
+	*(void**)block = pool->free[class];
+	pool->free[class] = block;
+	pthread_mutex_unlock(&pool->lock);
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <stdlib.h>
+#include <pthread.h>
+
+/* Amount of power of two size classes, the biggest block is 2^(n - 1) bytes */
+#define NEAT_POOL_CLASSES (sizeof(size_t) * 8)
+
+/* Recycles blocks of memory per power of two size class, freed blocks are
+ * kept in a singly linked list (the link is stored in the block itself) so
+ * allocating a block that has the same class as a freed one doesn't call
+ * malloc, it can be used from multiple threads at the same time
+ */
+struct neat_pool{
+	void *free[NEAT_POOL_CLASSES];
+
+	pthread_mutex_t lock;
+};
+
+void neat_pool_init(struct neat_pool *pool);
+/* Free all the blocks that are kept for recycling, the pool can't be used
+ * anymore after this
+ */
+void neat_pool_clear(struct neat_pool *pool);
+
+/* Lock the pool to guard data that's shared between the blocks, for example
+ * reference counts, this lock is not recursive
+ */
+void neat_pool_lock(struct neat_pool *pool);
+void neat_pool_unlock(struct neat_pool *pool);
+
+void *neat_pool_alloc(struct neat_pool *pool, size_t bytes);
+/* Return a block to the pool, bytes must be the same as when allocated */
+void neat_pool_free(struct neat_pool *pool, void *block, size_t bytes);
@@ -1,21 +1,49 @@
 #include "population.h"
+#include "parallel.h"
+#include "stream.h"
 
 #include <stdint.h>
+#include <string.h>
 #include <float.h>
+#include <limits.h>
+#include <time.h>
 #include <assert.h>
 
+/* Amount of species the lists have room for when the first one is added */
+#define NEAT_SPECIES_MINIMUM_COUNT 4
+/* Identifies a saved population and the version of the format */
+#define NEAT_SAVE_MAGIC "NEAT"
+#define NEAT_SAVE_VERSION 1
+/* The genomes are stored as a delta of their species representant */
+#define NEAT_SAVE_FLAG_DELTA 0x01
+
+/* Amount of members a parent is picked out of in a generation */
+#define NEAT_GENERATION_TOURNAMENT_SIZE 3
+
+/* Shuffle the ids of the active species in the scratch list of the population,
+ * the list is valid until the next call
+ */
 static size_t neat_random_eligible_species_list(struct neat_pop *p,
-						size_t **eligible_list)
+						const size_t **eligible_list)
 {
 	size_t i, eligible_count, *list;
 
 	assert(p);
 	assert(eligible_list);
 
-	*eligible_list = malloc(sizeof(size_t) * p->nspecies);
-	assert(*eligible_list);
+	/* The list is kept between the calls so it's only allocated when the
+	 * amount of species grows
+	 */
+	if(p->eligible_size < p->nspecies){
+		p->eligible_size = p->species_size;
+		p->eligible_species = realloc(p->eligible_species,
+					      sizeof(size_t) *
+					      p->eligible_size);
+		assert(p->eligible_species);
+	}
 
-	list = *eligible_list;
+	list = p->eligible_species;
+	*eligible_list = list;
 
 	/* First fill the array if the species are eligible */
 	eligible_count = 0;
@@ -27,9 +55,6 @@ static size_t neat_random_eligible_species_list(struct neat_pop *p,
 
 	/* If there are no eligible species create a new one */
 	if(eligible_count == 0){
-		free(list);
-		*eligible_list = NULL;
-
 		return 0;
 	}
 
@@ -40,7 +65,7 @@ static size_t neat_random_eligible_species_list(struct neat_pop *p,
 		/* Select a next random item starting from the current
 		 * position
 		 */
-		j = i + rand() / (RAND_MAX / (eligible_count - i) + 1);
+		j = i + nn_rng_index(&p->rng, eligible_count - i);
 
 		/* Swap the selected zitem with the current one */
 		tmp = list[j];
@@ -48,9 +73,6 @@ static size_t neat_random_eligible_species_list(struct neat_pop *p,
 		list[i] = tmp;
 	}
 
-	/* Resize the list to remove unneeded items */
-	*eligible_list = realloc(list, sizeof(size_t) * eligible_count);
-
 	return eligible_count;
 }
 
@@ -64,198 +86,532 @@ static void neat_reset_genomes(struct neat_pop *p)
 	/* All the genomes will be random at start */
 	innovation = p->innovation++;
 	for(i = 0; i < p->ngenomes; i++){
-		p->genomes[i] = neat_genome_create(p->conf, innovation);
+		p->genomes[i] = neat_genome_create(&p->pool,
+						   &p->rng,
+						   p->conf,
+						   innovation);
 	}
 }
 
-static void neat_replace_genome(struct neat_pop *p,
-				size_t dest,
-				struct neat_genome *src)
+/* The species are ordered on the adjusted fitness of their weakest genome
+ * that can be replaced, equal ones are ordered from the highest genome id
+ */
+static bool neat_worst_species_before(const void *data,
+				      size_t species1,
+				      size_t species2)
 {
-	assert(p);
-	assert(src);
-	assert(p->genomes[dest] != src);
+	const struct neat_pop *p;
+	struct neat_species *s1, *s2;
+	size_t genome1, genome2;
+	float fitness1, fitness2;
+
+	p = data;
+	s1 = p->species[species1];
+	s2 = p->species[species2];
+	genome1 = neat_species_select_weakest(s1);
+	genome2 = neat_species_select_weakest(s2);
+
+	fitness1 = neat_species_get_adjusted_fitness(s1,
+						     p->organisms[genome1].fitness);
+	fitness2 = neat_species_get_adjusted_fitness(s2,
+						     p->organisms[genome2].fitness);
+	if(fitness1 != fitness2){
+		return fitness1 < fitness2;
+	}
 
-	neat_genome_destroy(p->genomes[dest]);
-	p->genomes[dest] = neat_genome_copy(src);
+	return genome1 > genome2;
 }
 
-static struct neat_species *neat_create_new_species(struct neat_pop *p,
-						    bool fill)
+static void neat_worst_species_moved(void *data,
+				     size_t species_id,
+				     size_t index)
 {
-	struct neat_species *new;
+	struct neat_pop *p;
 
-	assert(p);
+	p = data;
+	p->species[species_id]->worst_index = index;
+}
 
-	p->species = realloc(p->species,
-			     sizeof(struct neat_species*) * ++p->nspecies);
-	assert(p->species);
+/* Update the place of the species in the worst heap after its weakest genome
+ * or its size changed
+ */
+static void neat_update_worst_species(struct neat_pop *p, size_t species_id)
+{
+	struct neat_species *species;
+	bool replaceable;
 
-	new = neat_species_create(p->conf);
+	assert(p);
+	assert(species_id < p->nspecies);
 
-	if(fill){
-		size_t i;
-		for(i = 0; i < p->ngenomes; i++){
-			neat_species_add_genome(new, i);
+	species = p->species[species_id];
+	replaceable = neat_species_select_weakest(species) != SIZE_MAX;
+	if(species->worst_index == SIZE_MAX){
+		if(replaceable){
+			neat_heap_push(&p->worst, species_id);
 		}
+	}else if(replaceable){
+		neat_heap_fix(&p->worst, species->worst_index);
+	}else{
+		neat_heap_remove(&p->worst, species->worst_index);
 	}
+}
+
+/* Dead species are queued so their genomes are replaced first */
+static void neat_kill_species(struct neat_pop *p, struct neat_species *species)
+{
+	assert(p);
+	assert(species);
+	assert(species->active);
 
-	p->species[p->nspecies - 1] = new;
+	species->active = false;
 
-	return new;
+	species->dead_prev = p->dead_last;
+	species->dead_next = NULL;
+	if(p->dead_last){
+		p->dead_last->dead_next = species;
+	}else{
+		p->dead_first = species;
+	}
+	p->dead_last = species;
 }
 
-static void neat_remove_species_if_empty(struct neat_pop *p, size_t species_id)
+static void neat_unqueue_dead_species(struct neat_pop *p,
+				      struct neat_species *species)
 {
-	struct neat_species *s;
-
 	assert(p);
-	assert(species_id < p->nspecies);
+	assert(species);
+	assert(!species->active);
 
-	s = p->species[species_id];
+	if(species->dead_prev){
+		species->dead_prev->dead_next = species->dead_next;
+	}else{
+		p->dead_first = species->dead_next;
+	}
+	if(species->dead_next){
+		species->dead_next->dead_prev = species->dead_prev;
+	}else{
+		p->dead_last = species->dead_prev;
+	}
+}
 
-	/* Only remove the species if there are no genomes left */
-	if(s->ngenomes > 0){
+/* Update the genomes that can be replaced after the age of the organism
+ * changed
+ */
+static void neat_update_eligibility(struct neat_pop *p, size_t genome_id)
+{
+	const struct neat_organism *organism;
+
+	assert(p);
+	assert(genome_id < p->ngenomes);
+
+	organism = p->organisms + genome_id;
+	if(organism->species == SIZE_MAX){
 		return;
 	}
 
-	neat_species_destroy(s);
+	neat_species_update_eligibility(p,
+					p->species[organism->species],
+					genome_id);
+	neat_update_worst_species(p, organism->species);
+}
 
-	/* Put the last species on this position
-	 * (this will do nothing if it already is the last one)
-	 */
-	p->species[species_id] = p->species[--p->nspecies];
-	p->species[p->nspecies] = NULL;
+size_t neat_organism_age(const struct neat_pop *p, size_t genome_id)
+{
+	const struct neat_organism *organism;
+
+	assert(p);
+	assert(genome_id < p->ngenomes);
+
+	organism = p->organisms + genome_id;
+
+	return p->clock - organism->birth + organism->time_alive;
 }
 
-static void neat_remove_genome_from_species(struct neat_pop *p,
-					    size_t genome_id)
+void neat_organism_born(struct neat_pop *p, size_t genome_id)
 {
-	size_t i;
+	struct neat_organism *organism;
+	struct neat_birth *birth;
 
-	for(i = 0; i < p->nspecies; i++){
-		if(neat_species_remove_genome_if_exists(p->species[i],
-							genome_id)){
-			neat_remove_species_if_empty(p, i);
-			/* Move i one back because the array has been
-			 * changed by the possible removal of the species
-			 */
-			i--;
+	assert(p);
+	assert(genome_id < p->ngenomes);
+
+	organism = p->organisms + genome_id;
+	organism->birth = p->clock;
+	organism->time_alive = 0;
+	organism->birth_id = p->nborn++;
+
+	/* Grow the ring buffer, the entries that wrapped around are moved
+	 * behind the old end
+	 */
+	if(p->nbirths == p->births_size){
+		size_t old_size, wrapped;
+
+		old_size = p->births_size;
+		p->births_size = old_size > 0 ? old_size * 2 : p->ngenomes;
+		p->births = realloc(p->births,
+				    sizeof(struct neat_birth) * p->births_size);
+		assert(p->births);
+
+		wrapped = p->births_start + p->nbirths - old_size;
+		if(p->births_start + p->nbirths > old_size){
+			memcpy(p->births + old_size,
+			       p->births,
+			       sizeof(struct neat_birth) * wrapped);
 		}
 	}
+
+	birth = p->births + (p->births_start + p->nbirths) % p->births_size;
+	birth->genome_id = genome_id;
+	birth->birth_id = organism->birth_id;
+	p->nbirths++;
+
+	/* It's too young to be replaced now */
+	neat_update_eligibility(p, genome_id);
+}
+
+/* Keep checking a young genome on every tick, the ticks added with
+ * neat_increase_time_alive can make it old enough before the genomes born
+ * before it
+ */
+static void neat_add_ahead(struct neat_pop *p, size_t genome_id)
+{
+	struct neat_organism *organism;
+
+	assert(p);
+	assert(genome_id < p->ngenomes);
+
+	organism = p->organisms + genome_id;
+	if(organism->ahead_index != SIZE_MAX){
+		return;
+	}
+
+	assert(p->nahead < p->ngenomes);
+	organism->ahead_index = p->nahead;
+	p->ahead[p->nahead++] = genome_id;
+}
+
+static void neat_remove_ahead(struct neat_pop *p, size_t genome_id)
+{
+	struct neat_organism *organism;
+	size_t last;
+
+	assert(p);
+	assert(genome_id < p->ngenomes);
+
+	organism = p->organisms + genome_id;
+	assert(organism->ahead_index < p->nahead);
+
+	/* Move the last genome in the list to the free position */
+	last = p->ahead[--p->nahead];
+	p->ahead[organism->ahead_index] = last;
+	p->organisms[last].ahead_index = organism->ahead_index;
+	organism->ahead_index = SIZE_MAX;
 }
 
-static float neat_adjusted_genome_fitness(struct neat_pop *p, size_t genome_id)
+/* Take the genomes that are old enough out of the birth queue, they're born in
+ * order so only the oldest ones and the ones that got extra ticks have to be
+ * checked
+ */
+static void neat_age_genomes(struct neat_pop *p)
 {
-	float fitness;
 	size_t i;
 
 	assert(p);
 
-	fitness = p->genomes[genome_id]->fitness;
+	while(p->nbirths > 0){
+		const struct neat_birth *birth;
 
-	for(i = 0; i < p->nspecies; i++){
-		if(neat_species_contains_genome(p->species[i], genome_id)){
-			return neat_species_get_adjusted_fitness(p->species[i],
-								 fitness);
+		birth = p->births + p->births_start;
+
+		/* Skip the genomes that have been replaced since */
+		if(p->organisms[birth->genome_id].birth_id == birth->birth_id){
+			if(neat_organism_age(p, birth->genome_id) <=
+			   p->conf.genome_minimum_ticks_alive){
+				break;
+			}
 
+			neat_update_eligibility(p, birth->genome_id);
 		}
+
+		p->births_start = (p->births_start + 1) % p->births_size;
+		p->nbirths--;
 	}
 
-	/* All genomes should be inside species */
-	assert(false);
+	i = p->nahead;
+	while(i-- > 0){
+		size_t genome_id;
+
+		/* Reborn genomes are in the birth queue again */
+		genome_id = p->ahead[i];
+		if(p->organisms[genome_id].time_alive > 0 &&
+		   neat_organism_age(p, genome_id) <=
+		   p->conf.genome_minimum_ticks_alive){
+			continue;
+		}
 
-	return 0.0f;
+		neat_update_eligibility(p, genome_id);
+		neat_remove_ahead(p, genome_id);
+	}
 }
 
-static int neat_sort_species_compare(const void *a, const void *b)
+/* Change the fitness and keep the sum and the order of the species up to
+ * date
+ */
+static void neat_set_organism_fitness(struct neat_pop *p,
+				      size_t genome_id,
+				      float fitness)
 {
-	float s1_fitness, s2_fitness;
-	struct neat_species *s1, *s2;
+	struct neat_organism *organism;
+	struct neat_species *species;
+
+	assert(p);
+	assert(genome_id < p->ngenomes);
 
-	s1 = *(struct neat_species**)a;
-	s2 = *(struct neat_species**)b;
+	organism = p->organisms + genome_id;
+	if(organism->species == SIZE_MAX){
+		organism->fitness = fitness;
+		return;
+	}
 
-	assert(s1);
-	assert(s2);
+	species = p->species[organism->species];
+	species->fitness_sum += (double)fitness - organism->fitness;
+	organism->fitness = fitness;
 
-	s1_fitness = s1->avg_fitness;
-	s2_fitness = s2->avg_fitness;
+	neat_species_update_fitness(p, species, genome_id);
+	neat_update_worst_species(p, organism->species);
+}
 
-	/* Sort from high to low */
-	if(s1_fitness < s2_fitness){
-		return 1;
-	}else if(s1_fitness > s2_fitness){
-		return -1;
-	}else{
-		return 0;
-	}
+static void neat_replace_genome(struct neat_pop *p,
+				size_t dest,
+				struct neat_genome *src)
+{
+	assert(p);
+	assert(src);
+	assert(p->genomes[dest] == NULL);
+
+	/* The slot takes over the reference of the source */
+	p->genomes[dest] = src;
+
+	/* The new organism starts from scratch */
+	neat_set_organism_fitness(p, dest, 0.0f);
+	neat_organism_born(p, dest);
+}
+
+static void neat_add_genome_to_species(struct neat_pop *p,
+				       size_t species_id,
+				       size_t genome_id)
+{
+	struct neat_organism *organism;
+	struct neat_species *species;
+
+	assert(p);
+	assert(species_id < p->nspecies);
+	assert(genome_id < p->ngenomes);
+
+	organism = p->organisms + genome_id;
+	species = p->species[species_id];
+
+	/* The genome shouldn't be in a species already */
+	assert(organism->species == SIZE_MAX);
+
+	organism->species = species_id;
+	neat_species_add_genome(p, species, genome_id);
+
+	species->fitness_sum += organism->fitness;
+
+	/* The adjusted fitness changes with the size of the species */
+	neat_update_worst_species(p, species_id);
+}
+
+/* Keep the chance the species is selected to reproduce up to date */
+static void neat_update_species_selection(struct neat_pop *p,
+					  size_t species_id)
+{
+	float avg_fitness;
+
+	assert(p);
+	assert(species_id < p->nspecies);
+
+	/* Negative weights would break the selection */
+	avg_fitness = p->species[species_id]->avg_fitness;
+	neat_fenwick_set(&p->selection,
+			 species_id,
+			 avg_fitness > 0.0f ? avg_fitness : 0.0);
 }
 
-static bool neat_find_worst_genome(struct neat_pop *p, size_t *worst_genome)
+/* Point the organisms of the species to its new position in the list */
+static void neat_update_species_index(struct neat_pop *p, size_t species_id)
 {
-	bool found_worst;
-	float worst_fitness;
+	struct neat_species *species;
 	size_t i;
 
 	assert(p);
-	assert(worst_genome);
+	assert(species_id < p->nspecies);
 
-	found_worst = false;
+	species = p->species[species_id];
+	species->id = species_id;
+	for(i = 0; i < species->ngenomes; i++){
+		p->organisms[species->genomes[i]].species = species_id;
+	}
 
-	/* First look if there are still dead species */
-	for(i = 0; i < p->nspecies; i++){
-		struct neat_species *species;
+	if(species->worst_index != SIZE_MAX){
+		p->worst.items[species->worst_index] = species_id;
+	}
+}
 
-		species = p->species[i];
+static struct neat_species *neat_create_new_species(struct neat_pop *p,
+						    bool fill)
+{
+	struct neat_species *new;
 
-		if(!species->active){
-			/* Just select the first genome in the species,
-			 * because when it will be removed the array will be
-			 * automatically slided left
-			 */
-			*worst_genome = species->genomes[0];
-			return true;
+	assert(p);
+
+	/* Double the size of the list so adding species is amortized constant
+	 * time
+	 */
+	if(p->nspecies == p->species_size){
+		p->species_size = p->species_size > 0 ?
+			p->species_size * 2 : NEAT_SPECIES_MINIMUM_COUNT;
+		p->species = realloc(p->species,
+				     sizeof(struct neat_species*) *
+				     p->species_size);
+		assert(p->species);
+	}
+
+	/* Reuse a removed species, its memory is already allocated */
+	if(p->free_species){
+		new = p->free_species;
+		p->free_species = new->next_free;
+		neat_species_reset(new);
+	}else{
+		if(p->nspecies_slots == p->species_slots_size){
+			p->species_slots_size = p->species_slots_size > 0 ?
+				p->species_slots_size * 2 :
+				NEAT_SPECIES_MINIMUM_COUNT;
+			p->species_slots = realloc(p->species_slots,
+						   sizeof(struct neat_species*) *
+						   p->species_slots_size);
+			assert(p->species_slots);
 		}
+
+		new = neat_species_create(p);
+		new->slot = p->nspecies_slots;
+		p->species_slots[p->nspecies_slots++] = new;
+	}
+
+	new->id = p->nspecies;
+	p->species[p->nspecies++] = new;
+	neat_fenwick_push(&p->selection, 0.0);
+	neat_update_species_selection(p, p->nspecies - 1);
+
+	if(fill){
+		size_t i;
+		for(i = 0; i < p->ngenomes; i++){
+			neat_add_genome_to_species(p, p->nspecies - 1, i);
+		}
+	}
+
+	return new;
+}
+
+static void neat_remove_species_if_empty(struct neat_pop *p, size_t species_id)
+{
+	struct neat_species *s;
+
+	assert(p);
+	assert(species_id < p->nspecies);
+
+	s = p->species[species_id];
+
+	/* Only remove the species if there are no genomes left */
+	if(s->ngenomes > 0){
+		return;
+	}
+
+	/* Without genomes it can't be in the worst heap anymore */
+	assert(s->worst_index == SIZE_MAX);
+
+	if(!s->active){
+		neat_unqueue_dead_species(p, s);
 	}
 
-	/* Finally check the rest, we iterate back so the same genome won't be
-	 * chosen when there are only dead species
+	/* Invalidate the handles of the species and keep it for later */
+	s->version++;
+	s->next_free = p->free_species;
+	p->free_species = s;
+
+	/* Put the last species on this position
+	 * (this will do nothing if it already is the last one)
 	 */
-	worst_fitness = FLT_MAX;
-	for(i = p->ngenomes; i > 0; i--){
-		struct neat_genome *genome;
-		float fitness;
+	p->species[species_id] = p->species[--p->nspecies];
+	p->species[p->nspecies] = NULL;
+	neat_fenwick_set(&p->selection,
+			 species_id,
+			 p->selection.weights[p->nspecies]);
+	neat_fenwick_pop(&p->selection);
 
-		genome = p->genomes[i - 1];
+	if(species_id < p->nspecies){
+		neat_update_species_index(p, species_id);
+	}
+}
 
-		/* Find the genome with the lowest adjusted fitness */
-		fitness = neat_adjusted_genome_fitness(p, i - 1);
-		if(fitness < worst_fitness &&
-		   genome->time_alive > p->conf.genome_minimum_ticks_alive){
-			*worst_genome = i - 1;
-			worst_fitness = fitness;
-			found_worst = true;
-		}
+static void neat_remove_genome_from_species(struct neat_pop *p,
+					    size_t genome_id)
+{
+	struct neat_organism *organism;
+	struct neat_species *species;
+	size_t species_id;
+
+	assert(p);
+	assert(genome_id < p->ngenomes);
+
+	organism = p->organisms + genome_id;
+	species_id = organism->species;
+	if(species_id == SIZE_MAX){
+		return;
 	}
 
-	return found_worst;
+	species = p->species[species_id];
+	species->fitness_sum -= organism->fitness;
+
+	neat_species_remove_genome_at(p, species, organism->species_index);
+	if(species->ngenomes == 0){
+		/* Don't keep rounding errors around */
+		species->fitness_sum = 0.0;
+	}
+	organism->species = SIZE_MAX;
+
+	neat_update_worst_species(p, species_id);
+	neat_remove_species_if_empty(p, species_id);
 }
 
-static float neat_get_total_fitness_average(struct neat_pop *p)
+bool neat_find_worst_genome(struct neat_pop *p, size_t *worst_genome)
 {
-	float total_avg;
-	size_t i;
+	struct neat_species *species;
 
 	assert(p);
+	assert(worst_genome);
 
-	total_avg = 0.0;
-	for(i = 0; i < p->nspecies; i++){
-		total_avg += p->species[i]->avg_fitness;
+	/* First look if there are still dead species */
+	if(p->dead_first){
+		/* Just select the first genome in the species, because when it
+		 * will be removed the array will be automatically slided left
+		 */
+		*worst_genome = p->dead_first->genomes[0];
+		return true;
+	}
+
+	/* Otherwise the genome with the lowest adjusted fitness that lived long
+	 * enough, it's the weakest genome of the species on top of the heap
+	 */
+	if(p->worst.nitems == 0){
+		return false;
 	}
-	total_avg /= (double)p->nspecies;
 
-	return total_avg;
+	species = p->species[p->worst.items[0]];
+	*worst_genome = neat_species_select_weakest(species);
+
+	return true;
 }
 
 static void neat_increase_all_species_generations(struct neat_pop *p)
@@ -277,6 +633,7 @@ static void neat_update_all_species_averages(struct neat_pop *p)
 
 	for(i = 0; i < p->nspecies; i++){
 		neat_species_update_average_fitness(p, p->species[i]);
+		neat_update_species_selection(p, i);
 	}
 }
 
@@ -295,7 +652,15 @@ static void neat_cull_species(struct neat_pop *p)
 		species = p->species[i - 1];
 		assert(species);
 
-		neat_species_cull(p, species);
+		if(!species->active){
+			continue;
+		}
+
+		/* Repopulating changes the fitness of the genomes */
+		if(neat_species_cull(p, species)){
+			neat_kill_species(p, species);
+		}
+		neat_update_worst_species(p, i - 1);
 	}
 }
 
@@ -345,9 +710,9 @@ static void neat_remove_duplicate_species(struct neat_pop *p)
 
 			/* Keep the species with the highest fitness */
 			if(s1->avg_fitness > s2->avg_fitness){
-				s2->active = false;
+				neat_kill_species(p, s2);
 			}else{
-				s1->active = false;
+				neat_kill_species(p, s1);
 				break;
 			}
 		}
@@ -359,7 +724,8 @@ static bool neat_add_genome_to_eligible_species(struct neat_pop *p,
 {
 	struct neat_genome *genome;
 	float compatibility_treshold;
-	size_t i, *eligible_species, eligible_count;
+	size_t i, eligible_count;
+	const size_t *eligible_species;
 
 	assert(p);
 
@@ -401,23 +767,17 @@ static bool neat_add_genome_to_eligible_species(struct neat_pop *p,
 					     species_representant,
 					     compatibility_treshold,
 					     p->nspecies)){
-			neat_species_add_genome(p->species[j], genome_id);
-
-			/* Cleanup */
-			free(eligible_species);
+			neat_add_genome_to_species(p, j, genome_id);
 			return true;
 		}
 	}
 
 	/* No compatible species found */
-	free(eligible_species);
 	return false;
 }
 
 static void neat_speciate_genome(struct neat_pop *p, size_t genome_id)
 {
-	struct neat_species *new;
-
 	assert(p);
 	assert(p->nspecies > 0);
 
@@ -425,59 +785,239 @@ static void neat_speciate_genome(struct neat_pop *p, size_t genome_id)
 		/* If no matching eligible species could be found create a
 		 * new species
 		 */
-		new = neat_create_new_species(p, false);
-		neat_species_add_genome(new, genome_id);
+		neat_create_new_species(p, false);
+		neat_add_genome_to_species(p, p->nspecies - 1, genome_id);
 	}
 }
 
-static void neat_respeciate_genomes(struct neat_pop *p)
-{
-	size_t i;
+/* Assignment of a genome that stays in its species */
+#define NEAT_RESPECIATE_KEEP (SIZE_MAX - 1)
 
-	assert(p);
+/* The representants of the active species at the start of a respeciation,
+ * every genome is compared against these in parallel
+ */
+struct neat_respeciation{
+	struct neat_pop *p;
 
-	for(i = 0; i < p->ngenomes; i++){
-		/* First remove the species, this will have the side effect
-		 * that representants will be shifted in species
-		 * TODO check if that's a problem
-		 */
-		neat_remove_genome_from_species(p, i);
+	struct neat_species **species;
+	size_t nspecies, total_species;
 
-		/* Then assign it to a existing species or create a new species
-		*/
-		neat_speciate_genome(p, i);
-	}
-}
+	/* Room for a shuffled list of nspecies indices per thread */
+	size_t *scratch;
+	/* Index in the snapshot per genome, SIZE_MAX if it's not compatible
+	 * with any of them
+	 */
+	size_t *assignment;
+};
 
-static struct neat_species *neat_interspecies_species(struct neat_pop *p,
-						      struct neat_species *s)
+static bool neat_is_active_representant(const struct neat_pop *p,
+					size_t genome_id)
 {
-	size_t i, eligible_count, *eligible_species;
+	const struct neat_organism *organism;
+	const struct neat_species *species;
 
-	eligible_species = NULL;
-	eligible_count = neat_random_eligible_species_list(p,
-							   &eligible_species);
-	if(eligible_count == 0){
-		return NULL;
+	organism = p->organisms + genome_id;
+	if(organism->species == SIZE_MAX){
+		return false;
 	}
-	assert(eligible_species);
-
-	for(i = 0; i < eligible_count; i++){
-		struct neat_species *s2 = p->species[eligible_species[i]];
-		assert(s2);
 
-		/* Parent2 cannot be the same as parent1 */
-		if(s2 != s){
-			return s2;
-		}
-	}
+	species = p->species[organism->species];
 
-	/* No eligible parent found */
-	return NULL;
+	return species->active && species->genomes[0] == genome_id;
 }
 
-static struct neat_genome *neat_crossover_get_parent2(struct neat_pop *p,
+/* Find a species for the genome, this only reads the population so it can run
+ * on multiple threads
+ */
+static void neat_respeciate_assign(void *data, size_t genome_id, size_t worker)
+{
+	struct neat_respeciation *r;
+	struct neat_genome *genome;
+	struct nn_rng rng;
+	size_t i, *list;
+
+	r = data;
+	assert(r);
+
+	/* Representants stay so the species they represent can't be emptied
+	 * while genomes are moved into it
+	 */
+	if(neat_is_active_representant(r->p, genome_id)){
+		r->assignment[genome_id] = NEAT_RESPECIATE_KEEP;
+		return;
+	}
+
+	/* Try the species in a random order so compatible species fill up
+	 * evenly, every genome has its own stream so the order doesn't depend
+	 * on the thread
+	 */
+	rng = nn_rng_derive(&r->p->rng, genome_id);
+	list = r->scratch + worker * r->nspecies;
+	for(i = 0; i < r->nspecies; i++){
+		size_t j;
+
+		j = nn_rng_index(&rng, i + 1);
+		if(j != i){
+			list[i] = list[j];
+		}
+		list[j] = i;
+	}
+
+	genome = r->p->genomes[genome_id];
+	r->assignment[genome_id] = SIZE_MAX;
+	for(i = 0; i < r->nspecies; i++){
+		struct neat_species *species;
+		size_t rep_id;
+
+		species = r->species[list[i]];
+		rep_id = neat_species_get_representant(species);
+		if(neat_genome_is_compatible(genome,
+					     r->p->genomes[rep_id],
+					     r->p->conf.genome_compatibility_treshold,
+					     r->total_species)){
+			r->assignment[genome_id] = list[i];
+			return;
+		}
+	}
+}
+
+/* Put a genome that's not compatible with any of the old species in a species
+ * that was created during this respeciation, or in a new one
+ * created	the species created so far, a new species is added to it
+ */
+static void neat_respeciate_unassigned(struct neat_pop *p,
+				       size_t genome_id,
+				       struct neat_species **created,
+				       size_t *ncreated)
+{
+	struct neat_species *species;
+	size_t i;
+
+	assert(p);
+	assert(created);
+	assert(ncreated);
+
+	for(i = 0; i < *ncreated; i++){
+		size_t rep_id;
+
+		rep_id = neat_species_get_representant(created[i]);
+		if(neat_genome_is_compatible(p->genomes[genome_id],
+					     p->genomes[rep_id],
+					     p->conf.genome_compatibility_treshold,
+					     p->nspecies)){
+			neat_add_genome_to_species(p, created[i]->id, genome_id);
+			return;
+		}
+	}
+
+	species = neat_create_new_species(p, false);
+	neat_add_genome_to_species(p, species->id, genome_id);
+	created[(*ncreated)++] = species;
+}
+
+void neat_respeciate_genomes(struct neat_pop *p)
+{
+	struct neat_respeciation r;
+	struct neat_species **created;
+	size_t i, threads, ncreated;
+
+	assert(p);
+
+	/* Snapshot the active species, their representants don't move */
+	r.p = p;
+	r.species = neat_arena_alloc(&p->arena,
+				     sizeof(struct neat_species*) * p->nspecies);
+	r.nspecies = 0;
+	for(i = 0; i < p->nspecies; i++){
+		if(p->species[i]->active){
+			r.species[r.nspecies++] = p->species[i];
+		}
+	}
+	r.total_species = p->nspecies;
+
+	threads = p->conf.threads > 0 ? p->conf.threads : 1;
+	r.scratch = neat_arena_alloc(&p->arena,
+				     sizeof(size_t) * threads * r.nspecies);
+	r.assignment = neat_arena_alloc(&p->arena,
+					sizeof(size_t) * p->ngenomes);
+
+	/* Compare every genome with the representants on all the threads */
+	neat_parallel_for(&p->parallel,
+			  p->ngenomes,
+			  threads,
+			  neat_respeciate_assign,
+			  &r);
+
+	/* Then move the genomes on this thread, in the order of their ids so
+	 * the result is always the same
+	 */
+	created = neat_arena_alloc(&p->arena,
+				   sizeof(struct neat_species*) * p->ngenomes);
+	ncreated = 0;
+	for(i = 0; i < p->ngenomes; i++){
+		size_t assignment;
+		struct neat_species *species;
+
+		assignment = r.assignment[i];
+		if(assignment == NEAT_RESPECIATE_KEEP){
+			continue;
+		}
+
+		if(assignment == SIZE_MAX){
+			neat_remove_genome_from_species(p, i);
+			neat_respeciate_unassigned(p, i, created, &ncreated);
+			continue;
+		}
+
+		/* The species still exists because its representant stays */
+		species = r.species[assignment];
+		if(p->organisms[i].species == species->id){
+			continue;
+		}
+
+		neat_remove_genome_from_species(p, i);
+		neat_add_genome_to_species(p, species->id, i);
+	}
+
+	/* The next respeciation shuffles the species in other orders */
+	nn_rng_next(&p->rng);
+
+	/* Sum the selection weights again so the rounding errors of all the
+	 * changes don't add up
+	 */
+	neat_fenwick_build(&p->selection);
+}
+
+static struct neat_species *neat_interspecies_species(struct neat_pop *p,
 						      struct neat_species *s)
+{
+	size_t i, eligible_count;
+	const size_t *eligible_species;
+
+	eligible_species = NULL;
+	eligible_count = neat_random_eligible_species_list(p,
+							   &eligible_species);
+	if(eligible_count == 0){
+		return NULL;
+	}
+	assert(eligible_species);
+
+	for(i = 0; i < eligible_count; i++){
+		struct neat_species *s2 = p->species[eligible_species[i]];
+		assert(s2);
+
+		/* Parent2 cannot be the same as parent1 */
+		if(s2 != s){
+			return s2;
+		}
+	}
+
+	/* No eligible parent found */
+	return NULL;
+}
+
+static size_t neat_crossover_get_parent2(struct neat_pop *p,
+					 struct neat_species *s)
 {
 	float random;
 	size_t genitor;
@@ -488,7 +1028,7 @@ static struct neat_genome *neat_crossover_get_parent2(struct neat_pop *p,
 
 	genitor = SIZE_MAX;
 
-	random = (float)rand() / (float)RAND_MAX;
+	random = nn_rng_float(&p->rng);
 	if(random < p->conf.interspecies_crossover_probability && false){
 		parent2_species = neat_interspecies_species(p, s);
 		if(parent2_species != NULL){
@@ -511,107 +1051,134 @@ static struct neat_genome *neat_crossover_get_parent2(struct neat_pop *p,
 		genitor = neat_species_select_second_genitor(p, s);
 	}
 
-	return p->genomes[genitor];
+	return genitor;
 }
 
 static void neat_crossover(struct neat_pop *p,
 			   struct neat_species *s,
 			   size_t worst_genome,
-			   struct neat_genome *parent)
+			   size_t parent_id)
 {
-	struct neat_genome *child;
+	struct neat_genome *child, *parent, *parent2, *worst;
+	size_t parent2_id;
 	float random;
 
 	assert(p);
 	assert(s);
+	assert(parent_id < p->ngenomes);
+	assert(parent_id != worst_genome);
+
+	parent = p->genomes[parent_id];
 	assert(parent);
 
-	random = (float)rand() / (float)RAND_MAX;
-	if(random < p->conf.species_crossover_probability){
-		struct neat_genome *parent2;
+	/* Take the worst genome out of the population, the child is written in
+	 * its storage
+	 */
+	worst = p->genomes[worst_genome];
+	p->genomes[worst_genome] = NULL;
+
+	parent2 = parent;
+	parent2_id = parent_id;
 
+	random = nn_rng_float(&p->rng);
+	if(random < p->conf.species_crossover_probability){
 		/* Do a crossover with 2 parents if parent2 is valid */
-		parent2 = neat_crossover_get_parent2(p, s);
+		parent2_id = neat_crossover_get_parent2(p, s);
+		parent2 = p->genomes[parent2_id];
+	}
 
-		if(parent == parent2){
-			/* Just copy one of the parents if they are the same */
-			child = neat_genome_copy(parent);
-		}else{
-			child = neat_genome_reproduce(parent, parent2);
-		}
+	if(parent == parent2){
+		/* Release the worst genome first so its block is on top of
+		 * the pool, a copy made by the mutation will then reuse it
+		 */
+		neat_genome_destroy(&p->pool, worst);
+
+		/* Just share the first parent if there is no crossover or if
+		 * they are the same
+		 */
+		child = neat_genome_share(parent);
 	}else{
-		/* Else copy the first parent */
-		child = neat_genome_copy(parent);
-	}
+		/* Take the most fit parent as the base */
+		if(p->organisms[parent2_id].fitness >
+		   p->organisms[parent_id].fitness){
+			parent2 = parent;
+			parent = p->genomes[parent2_id];
+		}
+
+		/* The worst genome can't be overwritten when it's a clone of
+		 * one of the parents
+		 */
+		if(worst == parent || worst == parent2){
+			neat_genome_destroy(&p->pool, worst);
+			worst = NULL;
+		}
 
-	neat_genome_mutate(child, p->conf, p->innovation);
+		child = neat_genome_reproduce(&p->pool, worst, parent, parent2);
+	}
 
-	/* Reset the time alive for the child */
-	child->time_alive = 0;
+	/* The child is only copied here if it's still shared and a mutation
+	 * actually changes it
+	 */
+	child = neat_genome_mutate(&p->pool,
+				   &p->rng,
+				   child,
+				   p->conf,
+				   p->innovation);
 
+	/* This also resets the time alive for the child */
 	neat_replace_genome(p, worst_genome, child);
-	neat_genome_destroy(child);
 }
 
-static void neat_reproduce(struct neat_pop *p, size_t worst_genome)
+size_t neat_select_species(struct neat_pop *p)
 {
-	float total_avg, selection_random;
-	size_t i;
+	double total, selection_random;
+	size_t species_id;
 
 	assert(p);
+	assert(p->nspecies > 0);
 
-	neat_update_all_species_averages(p);
-
-	neat_cull_species(p);
-
-	/* Sort species on fitness */
-	qsort(p->species,
-	      p->nspecies,
-	      sizeof(struct neat_species*),
-	      neat_sort_species_compare);
+	total = neat_fenwick_total(&p->selection);
+	selection_random = nn_rng_float(&p->rng);
+	if(total > 0.0){
+		return neat_fenwick_search(&p->selection,
+					   selection_random * total);
+	}
 
-	total_avg = neat_get_total_fitness_average(p);
+	species_id = (size_t)(selection_random * (double)p->nspecies);
+	if(species_id >= p->nspecies){
+		species_id = p->nspecies - 1;
+	}
 
-	selection_random = (float)rand() / (float)RAND_MAX;
-	for(i = 0; i < p->nspecies; i++){
-		struct neat_species *s;
-		struct neat_genome *genitor;
-		float selection_prob;
-		size_t genitor_id;
+	return species_id;
+}
 
-		s = p->species[i];
-		assert(s->ngenomes > 0);
+static void neat_reproduce(struct neat_pop *p, size_t worst_genome)
+{
+	struct neat_species *s;
+	size_t genitor_id;
 
-		selection_prob = s->avg_fitness / total_avg;
+	assert(p);
 
-		/* If we didn't find a match, 
-		 * reduce the chance to find a new one
-		 */
-		if(selection_random > selection_prob){
-			selection_random -= selection_prob;
-			continue;
-		}
+	neat_update_all_species_averages(p);
 
-		/* Select a random genome from the species, this will be the
-		 * replacement if there is no crossover and a parent when 
-		 * there is
-		 */
-		genitor_id = neat_species_select_genitor(p, s);
-		assert(genitor_id < p->ngenomes);
+	neat_cull_species(p);
 
-		genitor = p->genomes[genitor_id];
-		assert(genitor);
+	s = p->species[neat_select_species(p)];
+	assert(s->ngenomes > 0);
 
-		/* Crossover replaces the worst genome with a new one */
-		neat_crossover(p, s, worst_genome, genitor);
+	/* Select a random genome from the species, this will be the
+	 * replacement if there is no crossover and a parent when there is
+	 */
+	genitor_id = neat_species_select_genitor(p, s);
+	assert(genitor_id < p->ngenomes);
 
-		/* And then assign it to one or create a new one if no species
-		 * matches
-		 */
-		neat_speciate_genome(p, worst_genome);
+	/* Crossover replaces the worst genome with a new one */
+	neat_crossover(p, s, worst_genome, genitor_id);
 
-		break;
-	}
+	/* And then assign it to one or create a new one if no species
+	 * matches
+	 */
+	neat_speciate_genome(p, worst_genome);
 }
 
 struct neat_config neat_get_default_config(void)
@@ -620,7 +1187,7 @@ struct neat_config neat_get_default_config(void)
 	 * pretty way to initialize it
 	 */
 	struct neat_config conf = {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-		0, 0, 0, 0, 0};
+		0, 0, 0, 0, 0, 0, 0, 0, 0};
 
 	conf.minimum_time_before_replacement = 10;
 
@@ -643,12 +1210,16 @@ struct neat_config neat_get_default_config(void)
 	conf.genome_default_hidden_activation = NN_ACTIVATION_RELU;
 	conf.genome_default_output_activation = NN_ACTIVATION_SIGMOID;
 
+	conf.generation_replacement_fraction = 0.2;
+
 	return conf;
 }
 
-neat_t neat_create(struct neat_config config)
+/* Allocate a population without genomes and species */
+static struct neat_pop *neat_allocate(struct neat_config config)
 {
 	struct neat_pop *p;
+	size_t i;
 
 	assert(config.network_inputs > 0);
 	assert(config.network_outputs > 0);
@@ -666,11 +1237,62 @@ neat_t neat_create(struct neat_config config)
 	p->conf = config;
 	p->innovation = 1;
 
+	neat_pool_init(&p->pool);
+	neat_fenwick_init(&p->selection);
+	neat_arena_init(&p->arena);
+	neat_parallel_pool_init(&p->parallel);
+	neat_heap_init(&p->worst,
+		       neat_worst_species_before,
+		       neat_worst_species_moved,
+		       p);
+
+	/* Use a different seed every time if none is supplied */
+	if(config.seed != 0){
+		nn_rng_seed(&p->rng, config.seed);
+	}else{
+		nn_rng_seed(&p->rng, (unsigned long)time(NULL));
+	}
+
 	/* Create a genome and copy it n times where n is the population size */
 	p->ngenomes = config.population_size;
 	p->genomes = malloc(sizeof(struct neat_genome*) *
 			    config.population_size);
-	assert(p->ngenomes);
+	assert(p->genomes);
+	p->organisms = calloc(config.population_size,
+			      sizeof(struct neat_organism));
+	assert(p->organisms);
+	for(i = 0; i < config.population_size; i++){
+		p->organisms[i].species = SIZE_MAX;
+		p->organisms[i].ahead_index = SIZE_MAX;
+	}
+	p->ahead = malloc(sizeof(size_t) * config.population_size);
+	assert(p->ahead);
+
+	/* Round the memo table up to a power of two so the fingerprint can be
+	 * masked
+	 */
+	if(config.fitness_memo_size > 0){
+		p->nmemo = 1;
+		while(p->nmemo < config.fitness_memo_size){
+			p->nmemo <<= 1;
+		}
+		p->memo = calloc(p->nmemo, sizeof(struct neat_memo));
+		assert(p->memo);
+	}
+
+	return p;
+}
+
+neat_t neat_create(struct neat_config config)
+{
+	struct neat_pop *p;
+	size_t i;
+
+	p = neat_allocate(config);
+
+	for(i = 0; i < p->ngenomes; i++){
+		neat_organism_born(p, i);
+	}
 
 	neat_reset_genomes(p);
 
@@ -688,15 +1310,36 @@ void neat_destroy(neat_t population)
 	p = population;
 	assert(p);
 
+	neat_parallel_pool_clear(&p->parallel);
+
 	for(i = 0; i < p->ngenomes; i++){
-		neat_genome_destroy(p->genomes[i]);
+		neat_genome_destroy(&p->pool, p->genomes[i]);
 	}
 	free(p->genomes);
+	for(i = 0; i < p->ngenomes; i++){
+		free(p->organisms[i].neurons);
+	}
+	free(p->organisms);
+	free(p->births);
+	free(p->ahead);
+	free(p->memo);
 
-	for(i = 0; i < p->nspecies; i++){
-		neat_species_destroy(p->species[i]);
+	for(i = 0; i < p->nworkers; i++){
+		free(p->workers[i].neurons);
+	}
+	free(p->workers);
+
+	for(i = 0; i < p->nspecies_slots; i++){
+		neat_species_destroy(p->species_slots[i]);
 	}
+	free(p->species_slots);
 	free(p->species);
+	free(p->eligible_species);
+	neat_arena_clear(&p->arena);
+	neat_heap_clear(&p->worst);
+	neat_fenwick_clear(&p->selection);
+
+	neat_pool_clear(&p->pool);
 	free(p);
 }
 
@@ -704,14 +1347,31 @@ const float *neat_run(neat_t population, size_t genome_id, const float *inputs)
 {
 	struct neat_pop *p;
 
+	struct neat_organism *organism;
+	const struct nn_ffnet *net;
+
 	p = population;
 	assert(p);
 	assert(genome_id < p->ngenomes);
 
-	return neat_genome_run(p->genomes[genome_id], inputs);
+	/* Clones share their network, every organism runs it with its own
+	 * neurons so their outputs don't overwrite each other
+	 */
+	organism = p->organisms + genome_id;
+	net = p->genomes[genome_id]->net;
+	if(organism->nneurons < net->nneurons){
+		organism->neurons = realloc(organism->neurons,
+					    sizeof(float) * net->nneurons);
+		assert(organism->neurons);
+		organism->nneurons = net->nneurons;
+	}
+
+	return neat_genome_run(p->genomes[genome_id],
+			       inputs,
+			       organism->neurons);
 }
 
-bool neat_epoch(neat_t population, size_t *worst_genome)
+static bool neat_epoch_single(neat_t population, size_t *worst_genome)
 {
 	struct neat_pop *p;
 	size_t worst_found_genome, nspecies, reassignment_ticks;
@@ -720,6 +1380,11 @@ bool neat_epoch(neat_t population, size_t *worst_genome)
 	p = population;
 	assert(p);
 
+	/* Genomes aged with neat_increase_time_alive are not taken out of the
+	 * birth queue by neat_tick
+	 */
+	neat_age_genomes(p);
+
 	/* Wait for the set amount of ticks until a replacement occurs */
 	if(++p->ticks % p->conf.minimum_time_before_replacement != 0){
 		return false;
@@ -794,6 +1459,22 @@ bool neat_epoch(neat_t population, size_t *worst_genome)
 	return true;
 }
 
+bool neat_epoch(neat_t population, size_t *worst_genome)
+{
+	struct neat_pop *p;
+	bool replaced;
+
+	p = population;
+	assert(p);
+
+	replaced = neat_epoch_single(p, worst_genome);
+
+	/* Everything temporary of this epoch is released at once */
+	neat_arena_reset(&p->arena);
+
+	return replaced;
+}
+
 void neat_set_fitness(neat_t population, size_t genome_id, float fitness)
 {
 	struct neat_pop *p;
@@ -802,50 +1483,1180 @@ void neat_set_fitness(neat_t population, size_t genome_id, float fitness)
 	assert(p);
 	assert(genome_id < p->ngenomes);
 
-	p->genomes[genome_id]->fitness = fitness;
+	neat_set_organism_fitness(p, genome_id, fitness);
+
+	/* Remember the fitness for the clones, an older entry with the same
+	 * index is overwritten
+	 */
+	if(p->memo){
+		struct neat_memo *memo;
+		uint64_t fingerprint;
+
+		fingerprint = p->genomes[genome_id]->fingerprint;
+		memo = p->memo + (fingerprint & (p->nmemo - 1));
+		memo->fingerprint = fingerprint;
+		memo->fitness = fitness;
+		memo->used = true;
+	}
 }
 
-void neat_increase_time_alive(neat_t population, size_t genome_id)
+struct neat_evaluation{
+	struct neat_pop *p;
+	neat_fitness_func fitness;
+	void *user_data;
+
+	/* The stream of every genome is derived from the generator of the
+	 * population with the tick and the genome id
+	 */
+	unsigned long stream;
+	float *fitnesses;
+};
+
+static void neat_evaluate_genome(void *data, size_t genome_id, size_t worker)
+{
+	struct neat_evaluation *eval;
+	struct neat_worker *w;
+	const struct nn_ffnet *net;
+
+	eval = data;
+	assert(eval);
+	assert(worker < eval->p->nworkers);
+
+	w = eval->p->workers + worker;
+	net = eval->p->genomes[genome_id]->net;
+
+	/* The genomes don't all have the same amount of layers */
+	if(w->nneurons < net->nneurons){
+		w->neurons = realloc(w->neurons,
+				     sizeof(float) * net->nneurons);
+		assert(w->neurons);
+		w->nneurons = net->nneurons;
+	}
+
+	w->net = net;
+	w->rng = nn_rng_derive(&eval->p->rng, eval->stream + genome_id);
+
+	/* Every genome has its own entry so there are no races */
+	eval->fitnesses[genome_id] = eval->fitness(w,
+						   genome_id,
+						   eval->user_data);
+}
+
+void neat_evaluate_parallel(neat_t population,
+			    neat_fitness_func fitness,
+			    void *user_data,
+			    size_t threads)
 {
 	struct neat_pop *p;
+	struct neat_evaluation eval;
+	size_t i, nworkers;
 
 	p = population;
 	assert(p);
-	assert(genome_id < p->ngenomes);
+	assert(fitness);
+
+	nworkers = threads > 0 ? threads : 1;
+	if(p->nworkers < nworkers){
+		p->workers = realloc(p->workers,
+				     sizeof(struct neat_worker) * nworkers);
+		assert(p->workers);
+		for(i = p->nworkers; i < nworkers; i++){
+			p->workers[i].net = NULL;
+			p->workers[i].neurons = NULL;
+			p->workers[i].nneurons = 0;
+		}
+		p->nworkers = nworkers;
+	}
+
+	eval.p = p;
+	eval.fitness = fitness;
+	eval.user_data = user_data;
+	/* The generator of the population is left alone so evaluating in
+	 * parallel evolves the same as evaluating one by one
+	 */
+	eval.stream = (unsigned long)(p->clock * p->ngenomes);
+	eval.fitnesses = neat_arena_alloc(&p->arena,
+					  sizeof(float) * p->ngenomes);
+
+	neat_parallel_for(&p->parallel,
+			  p->ngenomes,
+			  threads,
+			  neat_evaluate_genome,
+			  &eval);
 
-	p->genomes[genome_id]->time_alive++;
+	/* The species are only updated by this thread */
+	for(i = 0; i < p->ngenomes; i++){
+		neat_set_fitness(p, i, eval.fitnesses[i]);
+	}
+
+	neat_arena_reset(&p->arena);
 }
 
-const struct nn_ffnet *neat_get_network(neat_t population, size_t genome_id)
+const float *neat_worker_run(struct neat_worker *worker, const float *inputs)
+{
+	assert(worker);
+	assert(worker->net);
+	assert(inputs);
+
+	return nn_ffnet_run_into(worker->net, inputs, worker->neurons);
+}
+
+struct nn_rng *neat_worker_get_rng(struct neat_worker *worker)
+{
+	assert(worker);
+
+	return &worker->rng;
+}
+
+bool neat_get_memoized_fitness(neat_t population,
+			       size_t genome_id,
+			       float *fitness)
 {
 	struct neat_pop *p;
+	const struct neat_memo *memo;
+	uint64_t fingerprint;
 
 	p = population;
 	assert(p);
 	assert(genome_id < p->ngenomes);
+	assert(fitness);
 
-	return p->genomes[genome_id]->net;
+	if(!p->memo){
+		return false;
+	}
+
+	fingerprint = p->genomes[genome_id]->fingerprint;
+	memo = p->memo + (fingerprint & (p->nmemo - 1));
+	if(!memo->used || memo->fingerprint != fingerprint){
+		return false;
+	}
+
+	*fitness = memo->fitness;
+
+	return true;
 }
 
-size_t neat_get_species_id(neat_t population, size_t genome_id)
+void neat_increase_time_alive(neat_t population, size_t genome_id)
 {
 	struct neat_pop *p;
-	size_t i;
 
 	p = population;
 	assert(p);
 	assert(genome_id < p->ngenomes);
 
-	/* Return the first species that contains the genome id (there should
-	 * only be one anyway)
-	 */
-	for(i = 0; i < p->nspecies; i++){
-		if(neat_species_contains_genome(p->species[i], genome_id)){
-			return i;
+	p->organisms[genome_id].time_alive++;
+	if(neat_organism_age(p, genome_id) > p->conf.genome_minimum_ticks_alive){
+		neat_update_eligibility(p, genome_id);
+	}else{
+		neat_add_ahead(p, genome_id);
+	}
+}
+
+void neat_tick(neat_t population)
+{
+	struct neat_pop *p;
+
+	p = population;
+	assert(p);
+
+	p->clock++;
+	neat_age_genomes(p);
+}
+
+/* Take the weakest genomes out of their species, they're replaced by the
+ * offspring of the generation
+ *
+ * return the amount of genomes that were found
+ */
+static size_t neat_generation_remove_weakest(struct neat_pop *p,
+					     size_t *victims,
+					     size_t count)
+{
+	size_t i;
+
+	assert(p);
+	assert(victims || count == 0);
+
+	for(i = 0; i < count; i++){
+		if(!neat_find_worst_genome(p, victims + i)){
+			break;
+		}
+
+		neat_remove_genome_from_species(p, victims[i]);
+	}
+
+	return i;
+}
+
+/* Divide the offspring over the species in proportion to their average
+ * fitness, the rest that's left after rounding down goes to randomly selected
+ * species
+ */
+static void neat_generation_offspring_species(struct neat_pop *p,
+					      size_t *species_ids,
+					      size_t count)
+{
+	double total;
+	size_t i, j, n;
+
+	assert(p);
+	assert(p->nspecies > 0);
+	assert(species_ids || count == 0);
+
+	total = neat_fenwick_total(&p->selection);
+
+	n = 0;
+	if(total > 0.0){
+		for(i = 0; i < p->nspecies && n < count; i++){
+			size_t quota;
+
+			quota = (size_t)((double)count *
+					 p->selection.weights[i] / total);
+			for(j = 0; j < quota && n < count; j++){
+				species_ids[n++] = i;
+			}
 		}
 	}
 
-	return 0;
+	for(; n < count; n++){
+		species_ids[n] = neat_select_species(p);
+	}
+}
+
+/* Create a child from parents out of the species, it still has to be mutated */
+static struct neat_genome *neat_generation_child(struct neat_pop *p,
+						 struct neat_species *s)
+{
+	size_t parent_id, parent2_id;
+
+	assert(p);
+	assert(s);
+
+	parent_id = neat_species_select_tournament(p,
+						   s,
+						   NEAT_GENERATION_TOURNAMENT_SIZE);
+
+	parent2_id = parent_id;
+	if(nn_rng_float(&p->rng) < p->conf.species_crossover_probability){
+		parent2_id = neat_species_select_tournament(p,
+							    s,
+							    NEAT_GENERATION_TOURNAMENT_SIZE);
+	}
+
+	if(p->genomes[parent_id] == p->genomes[parent2_id]){
+		return neat_genome_share(p->genomes[parent_id]);
+	}
+
+	/* Take the most fit parent as the base */
+	if(p->organisms[parent2_id].fitness > p->organisms[parent_id].fitness){
+		size_t tmp;
+
+		tmp = parent_id;
+		parent_id = parent2_id;
+		parent2_id = tmp;
+	}
+
+	return neat_genome_reproduce(&p->pool,
+				     NULL,
+				     p->genomes[parent_id],
+				     p->genomes[parent2_id]);
+}
+
+static size_t neat_epoch_all(neat_t population, size_t *replaced)
+{
+	struct neat_pop *p;
+	struct neat_genome **children;
+	struct nn_rng rng;
+	size_t i, count, nspecies, *victims, *species_ids;
+
+	p = population;
+	assert(p);
+	assert(p->conf.generation_replacement_fraction >= 0.0f);
+
+	neat_age_genomes(p);
+
+	/* At least one genome has to stay to be a parent */
+	count = (size_t)(p->conf.generation_replacement_fraction *
+			 (float)p->ngenomes);
+	if(count >= p->ngenomes){
+		count = p->ngenomes - 1;
+	}
+	if(count == 0){
+		return 0;
+	}
+
+	nspecies = p->nspecies;
+
+	p->innovation++;
+
+	/* The same bookkeeping as a single epoch, but only once for all the
+	 * offspring
+	 */
+	neat_increase_all_species_generations(p);
+	neat_update_all_species_averages(p);
+	neat_remove_duplicate_species(p);
+
+	victims = neat_arena_alloc(&p->arena, sizeof(size_t) * count);
+	count = neat_generation_remove_weakest(p, victims, count);
+	if(count == 0){
+		return 0;
+	}
+
+	/* The averages changed without the weakest members */
+	neat_update_all_species_averages(p);
+	neat_cull_species(p);
+
+	species_ids = neat_arena_alloc(&p->arena, sizeof(size_t) * count);
+	children = neat_arena_alloc(&p->arena,
+				    sizeof(struct neat_genome*) * count);
+
+	neat_generation_offspring_species(p, species_ids, count);
+
+	/* Release the replaced genomes first so the children can reuse their
+	 * blocks
+	 */
+	for(i = 0; i < count; i++){
+		neat_genome_destroy(&p->pool, p->genomes[victims[i]]);
+		p->genomes[victims[i]] = NULL;
+	}
+	for(i = 0; i < count; i++){
+		children[i] = neat_generation_child(p,
+						    p->species[species_ids[i]]);
+	}
+
+	/* Every child gets its own stream derived from a fresh generator, so
+	 * the amount of threads doesn't change the result
+	 */
+	rng = nn_rng_derive(&p->rng, nn_rng_next(&p->rng));
+	neat_genome_mutate_batch(&p->pool,
+				 &rng,
+				 children,
+				 count,
+				 p->conf,
+				 p->innovation,
+				 &p->parallel,
+				 p->conf.threads);
+
+	/* Put the children in the population and speciate them in one pass */
+	for(i = 0; i < count; i++){
+		neat_replace_genome(p, victims[i], children[i]);
+	}
+	for(i = 0; i < count; i++){
+		neat_speciate_genome(p, victims[i]);
+	}
+
+	if(replaced){
+		memcpy(replaced, victims, sizeof(size_t) * count);
+	}
+
+	/* Respeciate with the interval defined in the config when the
+	 * amount of species changed
+	 */
+	if(nspecies != p->nspecies &&
+	   p->conf.species_ticks_before_reassignment >=
+	   p->reassignment_ticks++){
+		neat_respeciate_genomes(p);
+		p->reassignment_ticks = 0;
+	}
+
+	return count;
+}
+
+size_t neat_epoch_generation(neat_t population, size_t *replaced)
+{
+	struct neat_pop *p;
+	size_t count;
+
+	p = population;
+	assert(p);
+
+	count = neat_epoch_all(p, replaced);
+
+	/* Everything temporary of this generation is released at once */
+	neat_arena_reset(&p->arena);
+
+	return count;
+}
+
+const struct nn_ffnet *neat_get_network(neat_t population, size_t genome_id)
+{
+	struct neat_pop *p;
+
+	p = population;
+	assert(p);
+	assert(genome_id < p->ngenomes);
+
+	return p->genomes[genome_id]->net;
+}
+
+void neat_get_genome_info(neat_t population,
+			  size_t genome_id,
+			  struct neat_genome_info *info)
+{
+	struct neat_pop *p;
+	const struct neat_genome *genome;
+
+	p = population;
+	assert(p);
+	assert(genome_id < p->ngenomes);
+	assert(info);
+
+	genome = p->genomes[genome_id];
+	info->nweights = genome->ninnov_weights;
+	info->nactivations = genome->ninnov_activs;
+	info->nhidden_layers = genome->net->nhidden_layers;
+	info->used_weights = genome->used_weights;
+	info->used_activations = genome->used_activs;
+	info->layer_weights = genome->layer_weights;
+	info->layer_activations = genome->layer_activs;
+}
+
+uint64_t neat_get_fingerprint(neat_t population, size_t genome_id)
+{
+	struct neat_pop *p;
+
+	p = population;
+	assert(p);
+	assert(genome_id < p->ngenomes);
+
+	return p->genomes[genome_id]->fingerprint;
+}
+
+size_t neat_encode_genome(neat_t population,
+			  size_t genome_id,
+			  void *buffer,
+			  size_t size)
+{
+	struct neat_pop *p;
+
+	p = population;
+	assert(p);
+	assert(genome_id < p->ngenomes);
+
+	return neat_genome_encode(p->genomes[genome_id], NULL, buffer, size);
+}
+
+size_t neat_encode_genome_delta(neat_t population,
+				size_t genome_id,
+				size_t parent_id,
+				void *buffer,
+				size_t size)
+{
+	struct neat_pop *p;
+
+	p = population;
+	assert(p);
+	assert(genome_id < p->ngenomes);
+	assert(parent_id < p->ngenomes);
+
+	return neat_genome_encode(p->genomes[genome_id],
+				  p->genomes[parent_id],
+				  buffer,
+				  size);
+}
+
+bool neat_decode_genome(neat_t population,
+			size_t genome_id,
+			const void *data,
+			size_t size)
+{
+	struct neat_pop *p;
+	struct neat_genome *genome, *parent;
+	uint64_t fingerprint;
+	size_t i;
+
+	p = population;
+	assert(p);
+	assert(genome_id < p->ngenomes);
+
+	/* Find the parent of a delta by its fingerprint */
+	parent = NULL;
+	if(neat_genome_encoded_parent(data, size, &fingerprint)){
+		for(i = 0; i < p->ngenomes; i++){
+			if(p->genomes[i]->fingerprint == fingerprint){
+				parent = p->genomes[i];
+				break;
+			}
+		}
+		if(!parent){
+			return false;
+		}
+	}
+
+	/* A network of another shape can't be run with the inputs of the
+	 * population or crossed with its genomes
+	 */
+	genome = neat_genome_decode(&p->pool, p->conf, data, size, parent);
+	if(!genome){
+		return false;
+	}
+
+	/* The new genome is speciated like a newborn, it might not be
+	 * compatible with the species of the old one
+	 */
+	neat_remove_genome_from_species(p, genome_id);
+	neat_genome_destroy(&p->pool, p->genomes[genome_id]);
+	p->genomes[genome_id] = NULL;
+	neat_replace_genome(p, genome_id, genome);
+
+	if(p->nspecies > 0){
+		neat_speciate_genome(p, genome_id);
+	}else{
+		neat_create_new_species(p, false);
+		neat_add_genome_to_species(p, 0, genome_id);
+	}
+
+	return true;
+}
+
+static void neat_write_config(struct neat_writer *w,
+			      const struct neat_config *c)
+{
+	neat_write_varint(w, c->network_inputs);
+	neat_write_varint(w, c->network_outputs);
+	neat_write_varint(w, c->network_hidden_nodes);
+	neat_write_varint(w, c->population_size);
+	neat_write_varint(w, c->minimum_time_before_replacement);
+	neat_write_varint(w, c->species_stagnation_treshold);
+	neat_write_varint(w, c->species_stagnations_allowed);
+	neat_write_varint(w, c->species_ticks_before_reassignment);
+	neat_write_float(w, c->species_crossover_probability);
+	neat_write_float(w, c->interspecies_crossover_probability);
+	neat_write_float(w, c->genome_add_neuron_mutation_probability);
+	neat_write_float(w, c->genome_add_link_mutation_probability);
+	neat_write_float(w, c->genome_change_activation_probability);
+	neat_write_float(w, c->genome_weight_mutation_probability);
+	neat_write_float(w, c->genome_all_weights_mutation_probability);
+	neat_write_varint(w, c->genome_minimum_ticks_alive);
+	neat_write_float(w, c->genome_compatibility_treshold);
+	neat_write_byte(w, (unsigned char)c->genome_default_hidden_activation);
+	neat_write_byte(w, (unsigned char)c->genome_default_output_activation);
+	neat_write_varint(w, c->seed);
+	neat_write_varint(w, c->fitness_memo_size);
+	neat_write_float(w, c->generation_replacement_fraction);
+	neat_write_varint(w, c->threads);
+}
+
+static bool neat_read_config(struct neat_reader *r, struct neat_config *c)
+{
+	c->network_inputs = (size_t)neat_read_varint(r);
+	c->network_outputs = (size_t)neat_read_varint(r);
+	c->network_hidden_nodes = (size_t)neat_read_varint(r);
+	c->population_size = (size_t)neat_read_varint(r);
+	c->minimum_time_before_replacement = (size_t)neat_read_varint(r);
+	c->species_stagnation_treshold = (size_t)neat_read_varint(r);
+	c->species_stagnations_allowed = (size_t)neat_read_varint(r);
+	c->species_ticks_before_reassignment = (size_t)neat_read_varint(r);
+	c->species_crossover_probability = neat_read_float(r);
+	c->interspecies_crossover_probability = neat_read_float(r);
+	c->genome_add_neuron_mutation_probability = neat_read_float(r);
+	c->genome_add_link_mutation_probability = neat_read_float(r);
+	c->genome_change_activation_probability = neat_read_float(r);
+	c->genome_weight_mutation_probability = neat_read_float(r);
+	c->genome_all_weights_mutation_probability = neat_read_float(r);
+	c->genome_minimum_ticks_alive = (size_t)neat_read_varint(r);
+	c->genome_compatibility_treshold = neat_read_float(r);
+	c->genome_default_hidden_activation =
+		(enum nn_activation)neat_read_byte(r);
+	c->genome_default_output_activation =
+		(enum nn_activation)neat_read_byte(r);
+	c->seed = (unsigned long)neat_read_varint(r);
+	c->fitness_memo_size = (size_t)neat_read_varint(r);
+	c->generation_replacement_fraction = neat_read_float(r);
+	c->threads = (size_t)neat_read_varint(r);
+
+	/* The same requirements as neat_create, the population size also
+	 * can't be bigger than the data because every genome takes bytes
+	 */
+	return !r->error &&
+		c->network_inputs > 0 &&
+		c->network_outputs > 0 &&
+		c->network_hidden_nodes > 0 &&
+		c->population_size > 0 &&
+		c->population_size <= r->size &&
+		c->minimum_time_before_replacement > 0 &&
+		(unsigned)c->genome_default_hidden_activation <
+		_NN_ACTIVATION_COUNT &&
+		(unsigned)c->genome_default_output_activation <
+		_NN_ACTIVATION_COUNT;
+}
+
+void neat_find_shared_genomes(struct neat_pop *p, size_t *shared)
+{
+	size_t i, ntable, *table;
+
+	assert(p);
+	assert(shared);
+
+	/* Open addressing table on the fingerprint, the same block always has
+	 * the same fingerprint
+	 */
+	ntable = 1;
+	while(ntable < p->ngenomes * 2){
+		ntable <<= 1;
+	}
+	table = neat_arena_alloc(&p->arena, sizeof(size_t) * ntable);
+	for(i = 0; i < ntable; i++){
+		table[i] = SIZE_MAX;
+	}
+
+	for(i = 0; i < p->ngenomes; i++){
+		const struct neat_genome *genome;
+		size_t j;
+
+		genome = p->genomes[i];
+		shared[i] = i;
+		if(genome->refs == 1){
+			continue;
+		}
+
+		j = (size_t)genome->fingerprint & (ntable - 1);
+		while(table[j] != SIZE_MAX){
+			if(p->genomes[table[j]] == genome){
+				shared[i] = table[j];
+				break;
+			}
+			j = (j + 1) & (ntable - 1);
+		}
+		if(shared[i] == i){
+			table[j] = i;
+		}
+	}
+}
+
+static void neat_write_population(struct neat_writer *w,
+				  const struct neat_pop *p,
+				  const size_t *shared,
+				  bool delta)
+{
+	size_t i, j, ndead;
+	const struct neat_species *species;
+	unsigned char *buffer;
+
+	neat_write_bytes(w, NEAT_SAVE_MAGIC, 4);
+	neat_write_varint(w, NEAT_SAVE_VERSION);
+	neat_write_byte(w, delta ? NEAT_SAVE_FLAG_DELTA : 0);
+
+	neat_write_config(w, &p->conf);
+
+	neat_write_byte(w, p->solved);
+	neat_write_varint(w, (uint64_t)p->innovation);
+	neat_write_varint(w, p->ticks);
+	neat_write_varint(w, p->reassignment_ticks);
+	neat_write_varint(w, p->clock);
+	neat_write_varint(w, p->nborn);
+	for(i = 0; i < 4; i++){
+		neat_write_fixed(w, p->rng.state[i], 4);
+	}
+
+	for(i = 0; i < p->ngenomes; i++){
+		const struct neat_genome *parent;
+		size_t parent_id, size, room, start;
+
+		/* A clone only refers to the first genome with its block */
+		if(shared[i] != i){
+			neat_write_varint(w, shared[i] + 1);
+			continue;
+		}
+		neat_write_varint(w, 0);
+
+		/* A delta against the representant that's already stored */
+		parent = NULL;
+		parent_id = SIZE_MAX;
+		if(delta && p->organisms[i].species != SIZE_MAX){
+			parent_id = neat_species_get_representant(
+				p->species[p->organisms[i].species]);
+			if(parent_id < i){
+				parent = p->genomes[parent_id];
+			}else{
+				parent_id = SIZE_MAX;
+			}
+		}
+		neat_write_varint(w, parent_id + 1);
+
+		/* The size is only known after encoding, so the genome is
+		 * encoded behind room for the longest size and moved in front
+		 * of it afterwards, it's only encoded again when the buffer
+		 * had to grow
+		 */
+		room = neat_write_reserve(w, NEAT_VARINT_MAX_SIZE);
+		room = room > NEAT_VARINT_MAX_SIZE ?
+			room - NEAT_VARINT_MAX_SIZE : 0;
+		buffer = room > 0 ? w->buffer + w->pos + NEAT_VARINT_MAX_SIZE :
+			NULL;
+		size = neat_genome_encode(p->genomes[i], parent, buffer, room);
+		if(size > room){
+			room = neat_write_reserve(w, NEAT_VARINT_MAX_SIZE + size);
+			room = room > NEAT_VARINT_MAX_SIZE ?
+				room - NEAT_VARINT_MAX_SIZE : 0;
+			if(room >= size){
+				neat_genome_encode(p->genomes[i],
+						   parent,
+						   w->buffer + w->pos +
+						   NEAT_VARINT_MAX_SIZE,
+						   size);
+			}
+		}
+
+		start = w->pos + NEAT_VARINT_MAX_SIZE;
+		neat_write_varint(w, size);
+		if(room >= size){
+			memmove(w->buffer + w->pos, w->buffer + start, size);
+		}
+		w->pos += size;
+	}
+
+	for(i = 0; i < p->ngenomes; i++){
+		const struct neat_organism *organism;
+
+		organism = p->organisms + i;
+		neat_write_float(w, organism->fitness);
+		neat_write_varint(w, organism->birth);
+		neat_write_varint(w, organism->time_alive);
+		neat_write_varint(w, organism->birth_id);
+	}
+
+	neat_write_varint(w, p->nbirths);
+	for(i = 0; i < p->nbirths; i++){
+		const struct neat_birth *birth;
+
+		birth = p->births + (p->births_start + i) % p->births_size;
+		neat_write_varint(w, birth->genome_id);
+		neat_write_varint(w, birth->birth_id);
+	}
+
+	neat_write_varint(w, p->nspecies);
+	for(i = 0; i < p->nspecies; i++){
+		species = p->species[i];
+		neat_write_byte(w, species->active);
+		neat_write_float(w, species->avg_fitness);
+		neat_write_float(w, species->max_avg_fitness);
+		neat_write_double(w, species->fitness_sum);
+		neat_write_varint(w, species->generation);
+		neat_write_varint(w, species->generation_with_max_fitness);
+		neat_write_varint(w, species->times_stagnated);
+
+		/* The order of the members decides the representant */
+		neat_write_varint(w, species->ngenomes);
+		for(j = 0; j < species->ngenomes; j++){
+			neat_write_varint(w, species->genomes[j]);
+		}
+
+		/* The selection tree is stored as it is so the rounding is the
+		 * same after loading
+		 */
+		neat_write_double(w, p->selection.weights[i]);
+		neat_write_double(w, p->selection.tree[i + 1]);
+	}
+
+	ndead = 0;
+	for(species = p->dead_first; species; species = species->dead_next){
+		ndead++;
+	}
+	neat_write_varint(w, ndead);
+	for(species = p->dead_first; species; species = species->dead_next){
+		neat_write_varint(w, species->id);
+	}
+}
+
+bool neat_save(neat_t population, FILE *file, bool compress)
+{
+	struct neat_pop *p;
+	struct neat_writer w;
+	size_t *shared;
+	bool written;
+
+	p = population;
+	assert(p);
+	assert(file);
+
+	shared = neat_arena_alloc(&p->arena, sizeof(size_t) * p->ngenomes);
+	neat_find_shared_genomes(p, shared);
+
+	/* Everything is written in memory first so it's written at once */
+	w.buffer = NULL;
+	w.size = w.pos = 0;
+	w.grow = true;
+	neat_write_population(&w, p, shared, compress);
+
+	written = fwrite(w.buffer, 1, w.pos, file) == w.pos;
+
+	free(w.buffer);
+	neat_arena_reset(&p->arena);
+
+	return written;
+}
+
+/* Read the whole file in memory, it can't be mapped because it may be a pipe
+ *
+ * return NULL if reading failed
+ */
+static unsigned char *neat_read_file(FILE *file, size_t *size)
+{
+	unsigned char *data;
+	size_t allocated;
+
+	allocated = 1 << 16;
+	data = malloc(allocated);
+	assert(data);
+
+	*size = 0;
+	for(;;){
+		size_t n;
+
+		n = fread(data + *size, 1, allocated - *size, file);
+		*size += n;
+		if(*size < allocated){
+			break;
+		}
+
+		allocated *= 2;
+		data = realloc(data, allocated);
+		assert(data);
+	}
+
+	if(ferror(file)){
+		free(data);
+		return NULL;
+	}
+
+	return data;
+}
+
+static bool neat_read_genomes(struct neat_reader *r,
+			      struct neat_pop *p,
+			      size_t *nloaded)
+{
+	size_t i;
+
+	for(i = 0; i < p->ngenomes; i++){
+		const void *data;
+		struct neat_genome *parent;
+		size_t shared, parent_id, size;
+
+		shared = (size_t)neat_read_varint(r);
+		if(shared > 0){
+			if(shared > i){
+				return false;
+			}
+			p->genomes[i] = neat_genome_share(p->genomes[shared - 1]);
+			*nloaded = i + 1;
+			continue;
+		}
+
+		parent_id = (size_t)neat_read_varint(r);
+		if(parent_id > i){
+			return false;
+		}
+		parent = parent_id > 0 ? p->genomes[parent_id - 1] : NULL;
+
+		size = (size_t)neat_read_varint(r);
+		data = neat_read_bytes(r, size);
+		if(!data){
+			return false;
+		}
+
+		/* All the genomes of a population have the same inputs,
+		 * outputs and layer size, the decoder checks it before the
+		 * network is allocated
+		 */
+		p->genomes[i] = neat_genome_decode(&p->pool,
+						   p->conf,
+						   data,
+						   size,
+						   parent);
+		if(!p->genomes[i]){
+			return false;
+		}
+		*nloaded = i + 1;
+	}
+
+	return !r->error;
+}
+
+static bool neat_read_organisms(struct neat_reader *r, struct neat_pop *p)
+{
+	size_t i, nbirths;
+
+	for(i = 0; i < p->ngenomes; i++){
+		struct neat_organism *organism;
+
+		organism = p->organisms + i;
+		organism->fitness = neat_read_float(r);
+		organism->birth = (size_t)neat_read_varint(r);
+		organism->time_alive = (size_t)neat_read_varint(r);
+		organism->birth_id = (size_t)neat_read_varint(r);
+		if(organism->birth > p->clock){
+			return false;
+		}
+	}
+
+	nbirths = (size_t)neat_read_varint(r);
+	if(r->error || nbirths > r->size){
+		return false;
+	}
+	p->births_size = nbirths > p->ngenomes ? nbirths : p->ngenomes;
+	p->births = malloc(sizeof(struct neat_birth) * p->births_size);
+	assert(p->births);
+	p->births_start = 0;
+	for(p->nbirths = 0; p->nbirths < nbirths; p->nbirths++){
+		struct neat_birth *birth;
+
+		birth = p->births + p->nbirths;
+		birth->genome_id = (size_t)neat_read_varint(r);
+		birth->birth_id = (size_t)neat_read_varint(r);
+		if(birth->genome_id >= p->ngenomes){
+			return false;
+		}
+	}
+
+	/* The genomes that got extra ticks aren't stored, they're the young
+	 * ones that have a time alive
+	 */
+	for(i = 0; i < p->ngenomes; i++){
+		if(p->organisms[i].time_alive > 0 &&
+		   neat_organism_age(p, i) <=
+		   p->conf.genome_minimum_ticks_alive){
+			neat_add_ahead(p, i);
+		}
+	}
+
+	return !r->error;
+}
+
+static bool neat_read_species(struct neat_reader *r, struct neat_pop *p)
+{
+	size_t i, j, nspecies, ndead, ninactive;
+	bool *stored_active;
+
+	nspecies = (size_t)neat_read_varint(r);
+	if(r->error || nspecies == 0 || nspecies > p->ngenomes){
+		return false;
+	}
+
+	/* The species are only killed when the dead queue is read, remember
+	 * which ones were stored as inactive to check the queue against them,
+	 * the arena is cleared by neat_destroy when reading fails
+	 */
+	stored_active = neat_arena_alloc(&p->arena, sizeof(bool) * nspecies);
+
+	ninactive = 0;
+	for(i = 0; i < nspecies; i++){
+		struct neat_species *species;
+		bool active;
+		float avg_fitness, max_avg_fitness;
+		double fitness_sum;
+		size_t ngenomes;
+
+		active = neat_read_byte(r) != 0;
+		avg_fitness = neat_read_float(r);
+		max_avg_fitness = neat_read_float(r);
+		fitness_sum = neat_read_double(r);
+
+		species = neat_create_new_species(p, false);
+		species->generation = (size_t)neat_read_varint(r);
+		species->generation_with_max_fitness =
+			(size_t)neat_read_varint(r);
+		species->times_stagnated = (size_t)neat_read_varint(r);
+
+		ngenomes = (size_t)neat_read_varint(r);
+		if(r->error || ngenomes == 0 || ngenomes > p->ngenomes){
+			return false;
+		}
+		for(j = 0; j < ngenomes; j++){
+			size_t genome_id;
+
+			genome_id = (size_t)neat_read_varint(r);
+			if(r->error || genome_id >= p->ngenomes ||
+			   p->organisms[genome_id].species != SIZE_MAX){
+				return false;
+			}
+			neat_add_genome_to_species(p, i, genome_id);
+		}
+
+		/* The sums were updated while adding, overwrite them with the
+		 * exact values
+		 */
+		species->avg_fitness = avg_fitness;
+		species->max_avg_fitness = max_avg_fitness;
+		species->fitness_sum = fitness_sum;
+		p->selection.weights[i] = neat_read_double(r);
+		p->selection.tree[i + 1] = neat_read_double(r);
+
+		stored_active[i] = active;
+		if(!active){
+			ninactive++;
+		}
+	}
+
+	/* Every genome is in a species after an epoch */
+	for(i = 0; i < p->ngenomes; i++){
+		if(p->organisms[i].species == SIZE_MAX){
+			return false;
+		}
+	}
+
+	ndead = (size_t)neat_read_varint(r);
+	if(r->error || ndead != ninactive){
+		return false;
+	}
+	for(i = 0; i < ndead; i++){
+		size_t species_id;
+
+		/* Only the inactive species are queued, each one once */
+		species_id = (size_t)neat_read_varint(r);
+		if(r->error || species_id >= p->nspecies ||
+		   stored_active[species_id] ||
+		   !p->species[species_id]->active){
+			return false;
+		}
+		neat_kill_species(p, p->species[species_id]);
+	}
+	neat_arena_reset(&p->arena);
+
+	return !r->error;
+}
+
+neat_t neat_load(FILE *file)
+{
+	struct neat_pop *p;
+	struct neat_reader r;
+	struct neat_config config;
+	unsigned char *data;
+	const void *magic;
+	size_t i, size, nloaded;
+	uint64_t innovation;
+	bool valid;
+
+	assert(file);
+
+	data = neat_read_file(file, &size);
+	if(!data){
+		return NULL;
+	}
+
+	r.data = data;
+	r.size = size;
+	r.pos = 0;
+	r.error = false;
+
+	/* Only the first version exists for now */
+	magic = neat_read_bytes(&r, 4);
+	if(!magic || memcmp(magic, NEAT_SAVE_MAGIC, 4) != 0 ||
+	   neat_read_varint(&r) != NEAT_SAVE_VERSION){
+		free(data);
+		return NULL;
+	}
+	neat_read_byte(&r);
+
+	/* Start from the defaults so fields that aren't in the file keep their
+	 * default value
+	 */
+	config = neat_get_default_config();
+	if(!neat_read_config(&r, &config)){
+		free(data);
+		return NULL;
+	}
+
+	p = neat_allocate(config);
+
+	p->solved = neat_read_byte(&r) != 0;
+	innovation = neat_read_varint(&r);
+	p->innovation = (int)innovation;
+	p->ticks = (size_t)neat_read_varint(&r);
+	p->reassignment_ticks = (size_t)neat_read_varint(&r);
+	p->clock = (size_t)neat_read_varint(&r);
+	p->nborn = (size_t)neat_read_varint(&r);
+	for(i = 0; i < 4; i++){
+		p->rng.state[i] = (uint32_t)neat_read_fixed(&r, 4);
+	}
+
+	nloaded = 0;
+	valid = !r.error && innovation > 0 && innovation <= INT_MAX &&
+		neat_read_genomes(&r, p, &nloaded) &&
+		neat_read_organisms(&r, p) &&
+		neat_read_species(&r, p) &&
+		r.pos == r.size;
+
+	free(data);
+
+	if(!valid){
+		/* Only the genomes that were read can be released */
+		for(i = 0; i < nloaded; i++){
+			neat_genome_destroy(&p->pool, p->genomes[i]);
+		}
+		p->ngenomes = 0;
+		neat_destroy(p);
+
+		return NULL;
+	}
+
+	return p;
+}
+
+size_t neat_get_species_id(neat_t population, size_t genome_id)
+{
+	struct neat_pop *p;
+	size_t species_id;
+
+	p = population;
+	assert(p);
+	assert(genome_id < p->ngenomes);
+
+	/* Return 0 for the genome that's between species during an epoch */
+	species_id = p->organisms[genome_id].species;
+	if(species_id == SIZE_MAX){
+		return 0;
+	}
+
+	return species_id;
+}
+
+uint64_t neat_get_species_handle(neat_t population, size_t genome_id)
+{
+	struct neat_pop *p;
+	const struct neat_species *species;
+	size_t species_id;
+
+	p = population;
+	assert(p);
+	assert(genome_id < p->ngenomes);
+
+	species_id = p->organisms[genome_id].species;
+	if(species_id == SIZE_MAX){
+		return NEAT_SPECIES_HANDLE_NONE;
+	}
+
+	/* The version is in the high bits so a reused slot gives another
+	 * handle
+	 */
+	species = p->species[species_id];
+	assert(species->slot < (uint64_t)0xFFFFFFFFUL);
+
+	return (uint64_t)species->version << 32 | (uint64_t)species->slot;
+}
+
+size_t neat_get_species_id_of_handle(neat_t population, uint64_t handle)
+{
+	struct neat_pop *p;
+	const struct neat_species *species;
+	size_t slot;
+
+	p = population;
+	assert(p);
+
+	slot = (size_t)(handle & (uint64_t)0xFFFFFFFFUL);
+	if(handle == NEAT_SPECIES_HANDLE_NONE || slot >= p->nspecies_slots){
+		return SIZE_MAX;
+	}
+
+	/* The version doesn't match anymore when the species was removed */
+	species = p->species_slots[slot];
+	if(species->version != (uint32_t)(handle >> 32)){
+		return SIZE_MAX;
+	}
+
+	return species->id;
 }
 
 size_t neat_get_num_species(neat_t population)
@@ -4,6 +4,64 @@
 
 #include "species.h"
 #include "genome.h"
+#include "pool.h"
+#include "heap.h"
+#include "fenwick.h"
+#include "arena.h"
+#include "parallel.h"
+
+/* The state of a single slot in the population, the genome itself is stored
+ * separately because it can be shared between multiple organisms
+ */
+struct neat_organism{
+	float fitness;
+
+	/* Tick of the population clock when it was born, the extra ticks added
+	 * with neat_increase_time_alive and the number of the birth in the
+	 * population
+	 */
+	size_t birth, time_alive, birth_id;
+
+	/* Index of the species the genome is in, its position in the species
+	 * and in the fitness heaps of the species, they're SIZE_MAX when it
+	 * isn't in one
+	 */
+	size_t species, species_index, fittest_index, weakest_index;
+	/* Position in the list of genomes that can become old enough before
+	 * their turn in the birth queue, SIZE_MAX when it isn't in it
+	 */
+	size_t ahead_index;
+
+	/* Neurons the network is run with by neat_run, the outputs stay valid
+	 * until the organism is run again
+	 */
+	float *neurons;
+	size_t nneurons;
+};
+
+/* Remembered fitness of a network with the fingerprint */
+struct neat_memo{
+	uint64_t fingerprint;
+	float fitness;
+	bool used;
+};
+
+/* Thread evaluating genomes, the network is run with its own neuron values so
+ * clones sharing a network can be run at the same time
+ */
+struct neat_worker{
+	const struct nn_ffnet *net;
+	float *neurons;
+	size_t nneurons;
+
+	/* Derived from the genome id so it doesn't depend on the thread */
+	struct nn_rng rng;
+};
+
+/* Entry in the queue of genomes that aren't old enough to be replaced */
+struct neat_birth{
+	size_t genome_id, birth_id;
+};
 
 struct neat_pop{
 	struct neat_config conf;
@@ -11,12 +69,111 @@ struct neat_pop{
 	bool solved;
 
 	struct neat_genome **genomes;
+	struct neat_organism *organisms;
 	size_t ngenomes;
 
+	/* Recycles the blocks of replaced genomes */
+	struct neat_pool pool;
+
+	/* The species by id, the list grows geometrically and keeps its
+	 * size when species are removed
+	 */
 	struct neat_species **species;
-	size_t nspecies;
+	size_t nspecies, species_size;
+	/* Every species object ever created by slot, removed species are put
+	 * in the free list to be reused for new species
+	 */
+	struct neat_species **species_slots;
+	size_t nspecies_slots, species_slots_size;
+	struct neat_species *free_species;
+	/* Scratch list used to visit the species in a random order */
+	size_t *eligible_species;
+	size_t eligible_size;
+	/* Average fitness of every species at the same index, used to select
+	 * the species that reproduces
+	 */
+	struct neat_fenwick selection;
+	/* Species that have genomes which can be replaced ordered on the
+	 * adjusted fitness of their weakest genome
+	 */
+	struct neat_heap worst;
+	/* Queue of inactive species, their genomes are replaced first */
+	struct neat_species *dead_first, *dead_last;
 
 	int innovation;
 
+	/* All the random decisions are made with this generator */
+	struct nn_rng rng;
+
 	size_t ticks, reassignment_ticks;
+
+	/* Advanced with neat_tick, the age of an organism is the difference
+	 * with its birth tick
+	 */
+	size_t clock;
+	/* Ring buffer with the genomes in the order they were born, they're
+	 * taken out when they're old enough, entries of replaced genomes are
+	 * recognized by their birth id
+	 */
+	struct neat_birth *births;
+	size_t births_start, nbirths, births_size;
+	size_t nborn;
+	/* Young genomes that got ticks with neat_increase_time_alive, they're
+	 * checked on every tick because they can pass the genomes in front of
+	 * them in the birth queue
+	 */
+	size_t *ahead;
+	size_t nahead;
+
+	/* Fitness memo table indexed by the lowest bits of the fingerprint,
+	 * the size is a power of two, NULL when it's disabled
+	 */
+	struct neat_memo *memo;
+	size_t nmemo;
+
+	/* Temporary data of an epoch, it's reset when the epoch is done */
+	struct neat_arena arena;
+
+	/* Scratch memory of the threads of neat_evaluate_parallel, it's kept
+	 * for the next evaluation
+	 */
+	struct neat_worker *workers;
+	size_t nworkers;
+
+	/* Threads of the parallel loops, they're kept alive until the
+	 * population is destroyed
+	 */
+	struct neat_parallel_pool parallel;
 };
+
+/* Amount of ticks the organism is alive, the ticks of the population clock and
+ * the ones added with neat_increase_time_alive
+ */
+size_t neat_organism_age(const struct neat_pop *p, size_t genome_id);
+/* Start the life of the organism in the slot again */
+void neat_organism_born(struct neat_pop *p, size_t genome_id);
+
+/* Move every genome to a compatible species, the representants of the active
+ * species stay and genomes that don't fit in any of them get new species
+ */
+void neat_respeciate_genomes(struct neat_pop *p);
+
+/* Select a species with a chance proportional to its average fitness, or any
+ * of them if none has a fitness yet
+ */
+size_t neat_select_species(struct neat_pop *p);
+
+/* Find the genome that's replaced next, a genome of a dead species or else the
+ * one with the lowest adjusted fitness that lived long enough
+ *
+ * return false if no genome can be replaced
+ */
+bool neat_find_worst_genome(struct neat_pop *p, size_t *worst_genome);
+
+/* Find the first genome that shares its block with every genome, clones share
+ * the block until they're mutated and are only stored once, the table is
+ * allocated from the arena of the population
+ * shared	where the index of the first genome with the same block is
+ *		written to, its own index when it's the first
+ */
+void neat_find_shared_genomes(struct neat_pop *p, size_t *shared);
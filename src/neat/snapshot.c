@@ -0,0 +1,597 @@
+/* Needed for mmap, the rest of the library only uses C90 */
+#define _POSIX_C_SOURCE 200112L
+
+#include "snapshot.h"
+#include "population.h"
+
+#include <string.h>
+#include <assert.h>
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#define NEAT_SNAPSHOT_MAGIC "NEATSNAP"
+#define NEAT_SNAPSHOT_VERSION 1
+/* Reads differently on a machine with another byte order */
+#define NEAT_SNAPSHOT_BYTE_ORDER ((uint64_t)0x0102030405060708UL)
+/* Stored for genomes that aren't in a species */
+#define NEAT_SNAPSHOT_NONE ((uint64_t)0xFFFFFFFFFFFFFFFFUL)
+
+/* Every part starts at a multiple of this so the fields can be read in
+ * place
+ */
+#define NEAT_SNAPSHOT_ALIGNMENT 8
+#define NEAT_SNAPSHOT_ALIGN(size) \
+	(((size) + NEAT_SNAPSHOT_ALIGNMENT - 1) / NEAT_SNAPSHOT_ALIGNMENT * \
+	 NEAT_SNAPSHOT_ALIGNMENT)
+
+static size_t neat_snapshot_network_size(const struct nn_ffnet *net)
+{
+	return NEAT_SNAPSHOT_ALIGN(sizeof(float) * net->nweights +
+				   net->nactivations);
+}
+
+bool neat_save_snapshot(neat_t population, FILE *file)
+{
+	struct neat_pop *p;
+	struct neat_snapshot_header *header;
+	struct neat_snapshot_genome *genomes;
+	struct neat_snapshot_species *species;
+	unsigned char *data;
+	size_t i, j, size, members_offset, network_offset, *shared, *offsets;
+	bool written;
+
+	p = population;
+	assert(p);
+	assert(file);
+
+	shared = neat_arena_alloc(&p->arena, sizeof(size_t) * p->ngenomes);
+	neat_find_shared_genomes(p, shared);
+
+	/* The tables come first, then the members of the species and the
+	 * networks
+	 */
+	size = NEAT_SNAPSHOT_ALIGN(sizeof(struct neat_snapshot_header));
+	size += sizeof(struct neat_snapshot_genome) * p->ngenomes;
+	size += sizeof(struct neat_snapshot_species) * p->nspecies;
+	members_offset = size;
+	for(i = 0; i < p->nspecies; i++){
+		size += sizeof(uint64_t) * p->species[i]->ngenomes;
+	}
+	network_offset = size;
+	for(i = 0; i < p->ngenomes; i++){
+		if(shared[i] == i){
+			size += neat_snapshot_network_size(p->genomes[i]->net);
+		}
+	}
+
+	/* Zeroed so the padding is always the same */
+	data = calloc(1, size);
+	assert(data);
+
+	header = (struct neat_snapshot_header*)data;
+	memcpy(header->magic, NEAT_SNAPSHOT_MAGIC, sizeof(header->magic));
+	header->version = NEAT_SNAPSHOT_VERSION;
+	header->byte_order = NEAT_SNAPSHOT_BYTE_ORDER;
+	header->size = size;
+	header->ninputs = p->conf.network_inputs;
+	header->nhiddens = p->conf.network_hidden_nodes;
+	header->noutputs = p->conf.network_outputs;
+	header->ngenomes = p->ngenomes;
+	header->nspecies = p->nspecies;
+	header->genomes_offset =
+		NEAT_SNAPSHOT_ALIGN(sizeof(struct neat_snapshot_header));
+	header->species_offset = header->genomes_offset +
+		sizeof(struct neat_snapshot_genome) * p->ngenomes;
+	header->innovation = (uint64_t)p->innovation;
+	header->clock = p->clock;
+
+	/* The network of a clone is found through the first genome sharing
+	 * it
+	 */
+	offsets = neat_arena_alloc(&p->arena, sizeof(size_t) * p->ngenomes);
+	genomes = (struct neat_snapshot_genome*)(data + header->genomes_offset);
+	for(i = 0; i < p->ngenomes; i++){
+		const struct neat_genome *genome;
+		const struct nn_ffnet *net;
+
+		genome = p->genomes[i];
+		net = genome->net;
+		if(shared[i] == i){
+			offsets[i] = network_offset;
+			memcpy(data + network_offset,
+			       net->weight,
+			       sizeof(float) * net->nweights);
+			memcpy(data + network_offset +
+			       sizeof(float) * net->nweights,
+			       net->activation,
+			       net->nactivations);
+			network_offset += neat_snapshot_network_size(net);
+		}else{
+			offsets[i] = offsets[shared[i]];
+		}
+
+		genomes[i].network_offset = offsets[i];
+		genomes[i].nhidden_layers = net->nhidden_layers;
+		genomes[i].nweights = net->nweights;
+		genomes[i].nactivations = net->nactivations;
+		genomes[i].fingerprint = genome->fingerprint;
+		genomes[i].species = p->organisms[i].species == SIZE_MAX ?
+			NEAT_SNAPSHOT_NONE : p->organisms[i].species;
+		genomes[i].age = neat_organism_age(p, i);
+		genomes[i].fitness = p->organisms[i].fitness;
+		genomes[i].bias = net->bias;
+	}
+	assert(network_offset == size);
+
+	species = (struct neat_snapshot_species*)(data + header->species_offset);
+	for(i = 0; i < p->nspecies; i++){
+		const struct neat_species *s;
+		uint64_t *members;
+
+		s = p->species[i];
+		species[i].members_offset = members_offset;
+		species[i].ngenomes = s->ngenomes;
+		species[i].active = s->active;
+		species[i].generation = s->generation;
+		species[i].times_stagnated = s->times_stagnated;
+		species[i].avg_fitness = s->avg_fitness;
+		species[i].max_avg_fitness = s->max_avg_fitness;
+
+		members = (uint64_t*)(data + members_offset);
+		for(j = 0; j < s->ngenomes; j++){
+			members[j] = s->genomes[j];
+		}
+		members_offset += sizeof(uint64_t) * s->ngenomes;
+	}
+
+	written = fwrite(data, 1, size, file) == size;
+
+	free(data);
+	neat_arena_reset(&p->arena);
+
+	return written;
+}
+
+/* Check that an array of count items of size bytes at the offset is inside
+ * the data
+ */
+static bool neat_snapshot_contains(const struct neat_snapshot *s,
+				   uint64_t offset,
+				   uint64_t count,
+				   size_t size)
+{
+	return offset <= s->size && count <= (s->size - offset) / size;
+}
+
+/* Multiply the counts read from the data without wrapping around
+ *
+ * return false if the product doesn't fit
+ */
+static bool neat_snapshot_multiply(uint64_t a, uint64_t b, uint64_t *product)
+{
+	if(b != 0 && a > ~(uint64_t)0 / b){
+		return false;
+	}
+	*product = a * b;
+
+	return true;
+}
+
+/* Add the weights of a layer to the total, it can never be more than the
+ * weights that are stored
+ */
+static bool neat_snapshot_add_layer(uint64_t *weights,
+				    uint64_t neurons,
+				    uint64_t inputs,
+				    uint64_t nweights)
+{
+	uint64_t layer_weights;
+
+	/* Every neuron also has a weight for the bias */
+	if(inputs == ~(uint64_t)0 ||
+	   !neat_snapshot_multiply(neurons, inputs + 1, &layer_weights) ||
+	   layer_weights > nweights - *weights){
+		return false;
+	}
+	*weights += layer_weights;
+
+	return true;
+}
+
+/* Check the counts of the network against the shape of the population, the
+ * counts in the file can be anything so nothing may overflow
+ */
+static bool neat_snapshot_validate_shape(const struct neat_snapshot_header *h,
+					 const struct neat_snapshot_genome *g)
+{
+	uint64_t hidden_activations, hidden_weights, weights;
+
+	if(!neat_snapshot_multiply(h->nhiddens,
+				   g->nhidden_layers,
+				   &hidden_activations) ||
+	   hidden_activations > g->nactivations ||
+	   g->nactivations - hidden_activations != h->noutputs){
+		return false;
+	}
+
+	weights = 0;
+	if(g->nhidden_layers == 0){
+		return neat_snapshot_add_layer(&weights,
+					       h->noutputs,
+					       h->ninputs,
+					       g->nweights) &&
+			weights == g->nweights;
+	}
+
+	/* The layers after the first one all have the same size */
+	if(!neat_snapshot_add_layer(&weights,
+				    h->nhiddens,
+				    h->ninputs,
+				    g->nweights) ||
+	   !neat_snapshot_multiply(h->nhiddens,
+				   g->nhidden_layers - 1,
+				   &hidden_weights) ||
+	   !neat_snapshot_add_layer(&weights,
+				    hidden_weights,
+				    h->nhiddens,
+				    g->nweights) ||
+	   !neat_snapshot_add_layer(&weights,
+				    h->noutputs,
+				    h->nhiddens,
+				    g->nweights)){
+		return false;
+	}
+
+	return weights == g->nweights;
+}
+
+static bool neat_snapshot_validate_genome(const struct neat_snapshot *s,
+					  size_t genome_id)
+{
+	const struct neat_snapshot_header *h;
+	const struct neat_snapshot_genome *g;
+	uint64_t activations_offset;
+
+	h = s->header;
+	g = s->genomes + genome_id;
+
+	if(g->network_offset % sizeof(float) != 0 ||
+	   !neat_snapshot_contains(s, g->network_offset, g->nweights,
+				   sizeof(float))){
+		return false;
+	}
+	activations_offset = g->network_offset + sizeof(float) * g->nweights;
+	if(!neat_snapshot_contains(s, activations_offset, g->nactivations, 1)){
+		return false;
+	}
+
+	return neat_snapshot_validate_shape(h, g) &&
+		(g->species == NEAT_SNAPSHOT_NONE || g->species < h->nspecies);
+}
+
+static bool neat_snapshot_validate(struct neat_snapshot *s)
+{
+	const struct neat_snapshot_header *h;
+	size_t i, j;
+
+	/* The fields can only be read in place when they're aligned */
+	if((size_t)s->data % NEAT_SNAPSHOT_ALIGNMENT != 0 ||
+	   s->size < sizeof(struct neat_snapshot_header)){
+		return false;
+	}
+
+	h = (const struct neat_snapshot_header*)s->data;
+	if(memcmp(h->magic, NEAT_SNAPSHOT_MAGIC, sizeof(h->magic)) != 0 ||
+	   h->version != NEAT_SNAPSHOT_VERSION ||
+	   h->byte_order != NEAT_SNAPSHOT_BYTE_ORDER ||
+	   h->size != s->size ||
+	   h->ninputs == 0 || h->ninputs > s->size ||
+	   h->nhiddens == 0 || h->nhiddens > s->size ||
+	   h->noutputs == 0 || h->noutputs > s->size ||
+	   h->genomes_offset % NEAT_SNAPSHOT_ALIGNMENT != 0 ||
+	   h->species_offset % NEAT_SNAPSHOT_ALIGNMENT != 0 ||
+	   !neat_snapshot_contains(s, h->genomes_offset, h->ngenomes,
+				   sizeof(struct neat_snapshot_genome)) ||
+	   !neat_snapshot_contains(s, h->species_offset, h->nspecies,
+				   sizeof(struct neat_snapshot_species))){
+		return false;
+	}
+	s->header = h;
+	s->genomes = (const struct neat_snapshot_genome*)
+		(s->data + h->genomes_offset);
+	s->species = (const struct neat_snapshot_species*)
+		(s->data + h->species_offset);
+
+	/* Only the tables are checked, the weights and activations are only
+	 * read when a network is used
+	 */
+	for(i = 0; i < h->ngenomes; i++){
+		if(!neat_snapshot_validate_genome(s, i)){
+			return false;
+		}
+	}
+
+	for(i = 0; i < h->nspecies; i++){
+		const struct neat_snapshot_species *species;
+		const uint64_t *members;
+
+		species = s->species + i;
+		if(species->members_offset % NEAT_SNAPSHOT_ALIGNMENT != 0 ||
+		   !neat_snapshot_contains(s, species->members_offset,
+					   species->ngenomes,
+					   sizeof(uint64_t))){
+			return false;
+		}
+
+		members = (const uint64_t*)(s->data + species->members_offset);
+		for(j = 0; j < species->ngenomes; j++){
+			if(members[j] >= h->ngenomes){
+				return false;
+			}
+		}
+	}
+
+	return true;
+}
+
+neat_snapshot_t neat_snapshot_open(const void *data, size_t size)
+{
+	struct neat_snapshot *s;
+
+	assert(data);
+
+	s = calloc(1, sizeof(struct neat_snapshot));
+	assert(s);
+	s->data = data;
+	s->size = size;
+	s->mapped = false;
+
+	if(!neat_snapshot_validate(s)){
+		free(s);
+		return NULL;
+	}
+
+	return s;
+}
+
+neat_snapshot_t neat_snapshot_map(const char *path)
+{
+	struct neat_snapshot *s;
+	struct stat st;
+	void *data;
+	int fd;
+
+	assert(path);
+
+	fd = open(path, O_RDONLY);
+	if(fd < 0){
+		return NULL;
+	}
+	if(fstat(fd, &st) != 0 || st.st_size <= 0){
+		close(fd);
+		return NULL;
+	}
+
+	/* The mapping stays valid after closing the file, the pages are only
+	 * read when they're used
+	 */
+	data = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if(data == MAP_FAILED){
+		return NULL;
+	}
+
+	s = neat_snapshot_open(data, (size_t)st.st_size);
+	if(!s){
+		munmap(data, (size_t)st.st_size);
+		return NULL;
+	}
+	s->mapped = true;
+
+	return s;
+}
+
+void neat_snapshot_close(neat_snapshot_t snapshot)
+{
+	struct neat_snapshot *s;
+
+	s = snapshot;
+	assert(s);
+
+	if(s->mapped){
+		munmap((void*)s->data, s->size);
+	}
+	free(s->neurons);
+	free(s);
+}
+
+const struct nn_ffnet *neat_snapshot_get_network(neat_snapshot_t snapshot,
+						 size_t genome_id)
+{
+	struct neat_snapshot *s;
+	const struct neat_snapshot_genome *g;
+	struct nn_ffnet *net;
+	size_t i;
+
+	s = snapshot;
+	assert(s);
+	assert(genome_id < s->header->ngenomes);
+
+	g = s->genomes + genome_id;
+
+	/* The network is used in place, only the sizes and the pointers are
+	 * filled in
+	 */
+	net = &s->net;
+	net->ninputs = s->header->ninputs;
+	net->nhiddens = s->header->nhiddens;
+	net->noutputs = s->header->noutputs;
+	net->nhidden_layers = g->nhidden_layers;
+	net->nweights = g->nweights;
+	net->nactivations = g->nactivations;
+	net->nneurons = net->ninputs + net->nactivations;
+	net->weight = (float*)(s->data + g->network_offset);
+	net->output = NULL;
+	net->activation = (char*)(net->weight + net->nweights);
+	net->bias = g->bias;
+
+	/* Unknown activations can't be run */
+	for(i = 0; i < net->nactivations; i++){
+		if((unsigned char)net->activation[i] >= _NN_ACTIVATION_COUNT){
+			return NULL;
+		}
+	}
+
+	return net;
+}
+
+const float *neat_run_snapshot(neat_snapshot_t snapshot,
+			       size_t genome_id,
+			       const float *inputs)
+{
+	struct neat_snapshot *s;
+	const struct nn_ffnet *net;
+
+	s = snapshot;
+	assert(s);
+
+	net = neat_snapshot_get_network(s, genome_id);
+	if(!net){
+		return NULL;
+	}
+
+	if(s->nneurons < net->nneurons){
+		s->neurons = realloc(s->neurons, sizeof(float) * net->nneurons);
+		assert(s->neurons);
+		s->nneurons = net->nneurons;
+	}
+
+	return nn_ffnet_run_into(net, inputs, s->neurons);
+}
+
+size_t neat_snapshot_get_num_genomes(neat_snapshot_t snapshot)
+{
+	struct neat_snapshot *s;
+
+	s = snapshot;
+	assert(s);
+
+	return s->header->ngenomes;
+}
+
+float neat_snapshot_get_fitness(neat_snapshot_t snapshot, size_t genome_id)
+{
+	struct neat_snapshot *s;
+
+	s = snapshot;
+	assert(s);
+	assert(genome_id < s->header->ngenomes);
+
+	return s->genomes[genome_id].fitness;
+}
+
+size_t neat_snapshot_get_age(neat_snapshot_t snapshot, size_t genome_id)
+{
+	struct neat_snapshot *s;
+
+	s = snapshot;
+	assert(s);
+	assert(genome_id < s->header->ngenomes);
+
+	return s->genomes[genome_id].age;
+}
+
+uint64_t neat_snapshot_get_fingerprint(neat_snapshot_t snapshot,
+				       size_t genome_id)
+{
+	struct neat_snapshot *s;
+
+	s = snapshot;
+	assert(s);
+	assert(genome_id < s->header->ngenomes);
+
+	return s->genomes[genome_id].fingerprint;
+}
+
+size_t neat_snapshot_get_species_id(neat_snapshot_t snapshot,
+				    size_t genome_id)
+{
+	struct neat_snapshot *s;
+	uint64_t species;
+
+	s = snapshot;
+	assert(s);
+	assert(genome_id < s->header->ngenomes);
+
+	species = s->genomes[genome_id].species;
+
+	return species == NEAT_SNAPSHOT_NONE ? SIZE_MAX : species;
+}
+
+size_t neat_snapshot_get_num_species(neat_snapshot_t snapshot)
+{
+	struct neat_snapshot *s;
+
+	s = snapshot;
+	assert(s);
+
+	return s->header->nspecies;
+}
+
+size_t neat_snapshot_get_num_genomes_in_species(neat_snapshot_t snapshot,
+						size_t species_id)
+{
+	struct neat_snapshot *s;
+
+	s = snapshot;
+	assert(s);
+	assert(species_id < s->header->nspecies);
+
+	return s->species[species_id].ngenomes;
+}
+
+size_t neat_snapshot_get_genome_in_species(neat_snapshot_t snapshot,
+					   size_t species_id,
+					   size_t index)
+{
+	struct neat_snapshot *s;
+	const uint64_t *members;
+
+	s = snapshot;
+	assert(s);
+	assert(species_id < s->header->nspecies);
+	assert(index < s->species[species_id].ngenomes);
+
+	members = (const uint64_t*)
+		(s->data + s->species[species_id].members_offset);
+
+	return members[index];
+}
+
+float neat_snapshot_get_average_fitness_of_species(neat_snapshot_t snapshot,
+						   size_t species_id)
+{
+	struct neat_snapshot *s;
+
+	s = snapshot;
+	assert(s);
+	assert(species_id < s->header->nspecies);
+
+	return s->species[species_id].avg_fitness;
+}
+
+bool neat_snapshot_get_species_is_alive(neat_snapshot_t snapshot,
+					size_t species_id)
+{
+	struct neat_snapshot *s;
+
+	s = snapshot;
+	assert(s);
+	assert(species_id < s->header->nspecies);
+
+	return s->species[species_id].active != 0;
+}
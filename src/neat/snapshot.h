@@ -0,0 +1,68 @@
+#pragma once
+
+#include <neat.h>
+
+#include <stdint.h>
+
+/* Layout of a snapshot, every part refers to the others with offsets from the
+ * start of the data so it can be used in place after mapping it, the numbers
+ * are stored in the byte order of the machine that wrote it and every field
+ * is 8 bytes so there's no padding
+ */
+struct neat_snapshot_header{
+	char magic[8];
+	uint64_t version;
+	/* NEAT_SNAPSHOT_BYTE_ORDER as it's stored on the writing machine */
+	uint64_t byte_order;
+	/* Size of the whole snapshot */
+	uint64_t size;
+
+	uint64_t ninputs, nhiddens, noutputs;
+	uint64_t ngenomes, nspecies;
+	/* Start of the genome and species tables */
+	uint64_t genomes_offset, species_offset;
+
+	uint64_t innovation, clock;
+};
+
+struct neat_snapshot_genome{
+	/* The weights of the network followed by its activations, clones
+	 * share the same network
+	 */
+	uint64_t network_offset;
+	uint64_t nhidden_layers, nweights, nactivations;
+	uint64_t fingerprint;
+
+	/* NEAT_SNAPSHOT_NONE when the genome isn't in a species */
+	uint64_t species;
+	uint64_t age;
+	float fitness, bias;
+};
+
+struct neat_snapshot_species{
+	/* Array of the ids of the member genomes */
+	uint64_t members_offset, ngenomes;
+	uint64_t active;
+	uint64_t generation, times_stagnated;
+	float avg_fitness, max_avg_fitness;
+};
+
+/* A snapshot that's being read, the data itself is never written to */
+struct neat_snapshot{
+	const unsigned char *data;
+	size_t size;
+	/* The data was mapped by neat_snapshot_map and has to be unmapped */
+	bool mapped;
+
+	const struct neat_snapshot_header *header;
+	const struct neat_snapshot_genome *genomes;
+	const struct neat_snapshot_species *species;
+
+	/* View on the network in the data returned by
+	 * neat_snapshot_get_network
+	 */
+	struct nn_ffnet net;
+	/* Scratch memory to run the networks with */
+	float *neurons;
+	size_t nneurons;
+};
@@ -5,20 +5,79 @@
 
 #include "population.h"
 
-static struct neat_genome *neat_genome_at(struct neat_pop *p,
-					  struct neat_species *species,
-					  size_t index)
+/* Amount of members a new species has room for */
+#define NEAT_SPECIES_MINIMUM_SIZE 4
+
+static void neat_species_resize(struct neat_species *species, size_t size)
 {
-	struct neat_genome *genome;
+	assert(species);
+	assert(size >= species->ngenomes);
 
-	assert(p);
-	assert(index < p->ngenomes);
-	assert(index < species->ngenomes);
+	species->genomes = realloc(species->genomes, sizeof(size_t) * size);
+	assert(species->genomes);
+	species->genomes_size = size;
+}
+
+/* The fittest genome is on top, equal ones are ordered on the position in the
+ * species so the first one of the best is always on top
+ */
+static bool neat_species_fittest_before(const void *data,
+					size_t genome1,
+					size_t genome2)
+{
+	const struct neat_pop *p;
+	const struct neat_organism *o1, *o2;
+
+	p = data;
+	o1 = p->organisms + genome1;
+	o2 = p->organisms + genome2;
+
+	if(o1->fitness != o2->fitness){
+		return o1->fitness > o2->fitness;
+	}
+
+	return o1->species_index < o2->species_index;
+}
+
+static void neat_species_fittest_moved(void *data,
+				       size_t genome_id,
+				       size_t index)
+{
+	struct neat_pop *p;
+
+	p = data;
+	p->organisms[genome_id].fittest_index = index;
+}
+
+/* The weakest genome that lived long enough is on top, equal ones are ordered
+ * from the highest id
+ */
+static bool neat_species_weakest_before(const void *data,
+					size_t genome1,
+					size_t genome2)
+{
+	const struct neat_pop *p;
+	const struct neat_organism *o1, *o2;
+
+	p = data;
+	o1 = p->organisms + genome1;
+	o2 = p->organisms + genome2;
 
-	genome = p->genomes[species->genomes[index]];
-	assert(genome);
+	if(o1->fitness != o2->fitness){
+		return o1->fitness < o2->fitness;
+	}
 
-	return genome;
+	return genome1 > genome2;
+}
+
+static void neat_species_weakest_moved(void *data,
+				       size_t genome_id,
+				       size_t index)
+{
+	struct neat_pop *p;
+
+	p = data;
+	p->organisms[genome_id].weakest_index = index;
 }
 
 static void neat_repopulate_species(struct neat_pop *p,
@@ -32,37 +91,71 @@ static void neat_repopulate_species(struct neat_pop *p,
 
 	first = p->genomes[species->genomes[0]];
 
-	/* Copy the first genome */
+	/* Share the first genome, it's only copied when it's mutated */
 	for(i = 1; i < species->ngenomes; i++){
 		size_t genome_id;
 
 		genome_id = species->genomes[i];
-		neat_genome_destroy(p->genomes[genome_id]);
-		p->genomes[genome_id] = neat_genome_copy(first);
+		neat_genome_destroy(&p->pool, p->genomes[genome_id]);
+		p->genomes[genome_id] = neat_genome_share(first);
+
+		p->organisms[genome_id].fitness = 0.0f;
+		neat_organism_born(p, genome_id);
 	}
+
+	/* Only the fitness of the first one is left */
+	species->fitness_sum = p->organisms[species->genomes[0]].fitness;
+
+	/* Almost all the fitnesses changed so the heap is built again */
+	neat_heap_build(&species->fittest);
 }
 
-struct neat_species *neat_species_create(struct neat_config config)
+struct neat_species *neat_species_create(struct neat_pop *p)
 {
 	struct neat_species *species;
 
-	assert(config.population_size > 0);
+	assert(p);
 
 	species = calloc(1, sizeof(struct neat_species));
 	assert(species);
 
+	/* Start small, most species only have a few members */
+	neat_species_resize(species, NEAT_SPECIES_MINIMUM_SIZE);
+
+	neat_heap_init(&species->fittest,
+		       neat_species_fittest_before,
+		       neat_species_fittest_moved,
+		       p);
+	neat_heap_init(&species->weakest,
+		       neat_species_weakest_before,
+		       neat_species_weakest_moved,
+		       p);
+
+	neat_species_reset(species);
+
+	return species;
+}
+
+void neat_species_reset(struct neat_species *species)
+{
+	assert(species);
+	assert(species->ngenomes == 0);
+	assert(species->fittest.nitems == 0);
+	assert(species->weakest.nitems == 0);
+
 	/* We start new species as active ones because we assert that they will
 	 * be filled with at least one genome
 	 */
 	species->active = true;
 
-	/* Create all the genomes but don't use them yet, so we don't have
-	 * to resize the array when species gets added or removed
-	 */
-	species->genomes = calloc(config.population_size, sizeof(size_t));
-	assert(species->genomes);
+	species->avg_fitness = species->max_avg_fitness = 0.0f;
+	species->fitness_sum = 0.0;
+	species->generation = species->generation_with_max_fitness = 0;
+	species->times_stagnated = 0;
 
-	return species;
+	species->worst_index = SIZE_MAX;
+	species->dead_prev = species->dead_next = NULL;
+	species->next_free = NULL;
 }
 
 void neat_species_destroy(struct neat_species *species)
@@ -71,6 +164,8 @@ void neat_species_destroy(struct neat_species *species)
 	assert(species->genomes);
 
 	free(species->genomes);
+	neat_heap_clear(&species->fittest);
+	neat_heap_clear(&species->weakest);
 	free(species);
 }
 
@@ -86,8 +181,7 @@ float neat_species_get_adjusted_fitness(struct neat_species *species,
 float neat_species_update_average_fitness(struct neat_pop *p,
 					  struct neat_species *species)
 {
-	float sum_fitness;
-	size_t i;
+	float avg_fitness;
 
 	assert(p);
 	assert(species);
@@ -96,12 +190,8 @@ float neat_species_update_average_fitness(struct neat_pop *p,
 		return 0.0f;
 	}
 
-	sum_fitness = 0.0f;
-	for(i = 0; i < species->ngenomes; i++){
-		sum_fitness += neat_genome_at(p, species, i)->fitness;
-	}
-
-	species->avg_fitness = sum_fitness / (float)species->ngenomes;
+	avg_fitness = species->fitness_sum / (double)species->ngenomes;
+	species->avg_fitness = avg_fitness;
 
 	/* Update the maximum average fitness */
 	if(species->max_avg_fitness < species->avg_fitness){
@@ -139,8 +229,6 @@ bool neat_species_cull(struct neat_pop *p, struct neat_species *species)
 		times_stagnated = ++species->times_stagnated;
 		if(times_stagnated > p->conf.species_stagnations_allowed){
 			/* The maximum amount of stagnations is reached now */
-			species->active = false;
-
 			return true;
 		}else{
 			species->generation_with_max_fitness = gen;
@@ -158,37 +246,31 @@ bool neat_species_cull(struct neat_pop *p, struct neat_species *species)
 size_t neat_species_select_genitor(struct neat_pop *p,
 				   struct neat_species *species)
 {
-	size_t i, best_genome;
-	float best_fitness;
+	size_t best_genome;
 
 	assert(p);
 	assert(species);
 	assert(species->ngenomes > 0);
-	
-	/* Return the genome in this species with the highest fitness */
-	best_genome = 0;
-	best_fitness = 0.0f;
-	for(i = 0; i < species->ngenomes; i++){
-		float fitness;
-	
-		fitness = neat_genome_at(p, species, i)->fitness;
-		if(best_fitness < fitness){
-			best_fitness = fitness;
-			best_genome = i;
-		}
+
+	/* Return the genome in this species with the highest fitness, the
+	 * first one if none of them has a fitness yet
+	 */
+	best_genome = species->fittest.items[0];
+	if(p->organisms[best_genome].fitness <= 0.0f){
+		return species->genomes[0];
 	}
 
-	return species->genomes[best_genome];
+	return best_genome;
 }
 
 size_t neat_species_select_second_genitor(struct neat_pop *p,
 					  struct neat_species *species)
 {
-	size_t i, best_genome, second_best_genome;
-	float best_fitness, second_best_fitness;
+	size_t second_best_genome;
 
 	assert(p);
 	assert(species);
+	assert(species->ngenomes > 0);
 
 	/* If there is only one genome in the species there are not that many
 	 * options to choose from
@@ -197,30 +279,91 @@ size_t neat_species_select_second_genitor(struct neat_pop *p,
 		return species->genomes[0];
 	}
 
-	/* TODO choose randomly between one of the best instead of the
-	 * second best one, the current algorithm is highly flawed because it
-	 * doesn't really select the second best one
-	 */
-	
-	best_genome = second_best_genome = 0;
-	best_fitness = second_best_fitness = 0.0f;
-	for(i = 0; i < species->ngenomes; i++){
-		float fitness;
-	
-		fitness = neat_genome_at(p, species, i)->fitness;
-		if(best_fitness <= fitness){
-			second_best_fitness = best_fitness;
-			second_best_genome = best_genome;
-
-			best_fitness = fitness;
-			best_genome = i;
-		}else if(second_best_fitness < fitness){
-			second_best_fitness = fitness;
-			second_best_genome = i;
+	/* The second best one is one of the children of the best one */
+	second_best_genome = species->fittest.items[1];
+	if(species->ngenomes > 2 &&
+	   neat_species_fittest_before(p,
+				       species->fittest.items[2],
+				       second_best_genome)){
+		second_best_genome = species->fittest.items[2];
+	}
+
+	return second_best_genome;
+}
+
+size_t neat_species_select_tournament(struct neat_pop *p,
+				      struct neat_species *species,
+				      size_t size)
+{
+	size_t i, best_genome;
+
+	assert(p);
+	assert(species);
+	assert(species->ngenomes > 0);
+	assert(size > 0);
+
+	best_genome = species->genomes[nn_rng_index(&p->rng,
+						    species->ngenomes)];
+	for(i = 1; i < size; i++){
+		size_t genome_id;
+
+		genome_id = species->genomes[nn_rng_index(&p->rng,
+							  species->ngenomes)];
+		if(neat_species_fittest_before(p, genome_id, best_genome)){
+			best_genome = genome_id;
 		}
 	}
 
-	return species->genomes[second_best_genome];
+	return best_genome;
+}
+
+void neat_species_update_fitness(struct neat_pop *p,
+				 struct neat_species *species,
+				 size_t genome_id)
+{
+	const struct neat_organism *organism;
+
+	assert(p);
+	assert(species);
+	assert(genome_id < p->ngenomes);
+
+	organism = p->organisms + genome_id;
+	neat_heap_fix(&species->fittest, organism->fittest_index);
+	if(organism->weakest_index != SIZE_MAX){
+		neat_heap_fix(&species->weakest, organism->weakest_index);
+	}
+}
+
+void neat_species_update_eligibility(struct neat_pop *p,
+				     struct neat_species *species,
+				     size_t genome_id)
+{
+	const struct neat_organism *organism;
+	bool eligible;
+
+	assert(p);
+	assert(species);
+	assert(genome_id < p->ngenomes);
+
+	organism = p->organisms + genome_id;
+	eligible = neat_organism_age(p, genome_id) >
+		p->conf.genome_minimum_ticks_alive;
+	if(eligible && organism->weakest_index == SIZE_MAX){
+		neat_heap_push(&species->weakest, genome_id);
+	}else if(!eligible && organism->weakest_index != SIZE_MAX){
+		neat_heap_remove(&species->weakest, organism->weakest_index);
+	}
+}
+
+size_t neat_species_select_weakest(struct neat_species *species)
+{
+	assert(species);
+
+	if(species->weakest.nitems == 0){
+		return SIZE_MAX;
+	}
+
+	return species->weakest.items[0];
 }
 
 size_t neat_species_get_representant(struct neat_species *species)
@@ -232,24 +375,80 @@ size_t neat_species_get_representant(struct neat_species *species)
 	return species->genomes[0];
 }
 
-void neat_species_add_genome(struct neat_species *species,
+void neat_species_add_genome(struct neat_pop *p,
+			     struct neat_species *species,
 			     size_t genome_id)
 {
+	assert(p);
 	assert(species);
+	assert(genome_id < p->ngenomes);
 
-	/* The genome shouldn't be there already */
-	assert(!neat_species_contains_genome(species, genome_id));
+	/* Double the size so adding is amortized constant time */
+	if(species->ngenomes == species->genomes_size){
+		neat_species_resize(species, species->genomes_size * 2);
+	}
 
 	species->genomes[species->ngenomes] = genome_id;
+	p->organisms[genome_id].species_index = species->ngenomes;
 	species->ngenomes++;
 
+	neat_heap_push(&species->fittest, genome_id);
+	p->organisms[genome_id].weakest_index = SIZE_MAX;
+	neat_species_update_eligibility(p, species, genome_id);
+
 	/* Reset the generation counter */
 	species->max_avg_fitness = 0.0f;
 	species->generation = 0;
 	species->generation_with_max_fitness = 0;
 }
 
-bool neat_species_remove_genome_if_exists(struct neat_species *species,
+void neat_species_remove_genome_at(struct neat_pop *p,
+				   struct neat_species *species,
+				   size_t index)
+{
+	const struct neat_organism *organism;
+	size_t last;
+
+	assert(p);
+	assert(species);
+	assert(index < species->ngenomes);
+
+	organism = p->organisms + species->genomes[index];
+	neat_heap_remove(&species->fittest, organism->fittest_index);
+	if(organism->weakest_index != SIZE_MAX){
+		neat_heap_remove(&species->weakest, organism->weakest_index);
+	}
+
+	species->ngenomes--;
+	last = species->ngenomes;
+
+	/* Put the last genome on this position
+	 * (this will do nothing if it already is the last one)
+	 */
+	if(index != last){
+		size_t moved;
+
+		moved = species->genomes[last];
+		species->genomes[index] = moved;
+		p->organisms[moved].species_index = index;
+
+		/* It comes before the equal ones now */
+		neat_heap_fix(&species->fittest,
+			      p->organisms[moved].fittest_index);
+	}
+	species->genomes[last] = SIZE_MAX;
+
+	/* Halve the size when it's mostly empty, not at the half so adding and
+	 * removing around it doesn't resize every time
+	 */
+	if(species->genomes_size > NEAT_SPECIES_MINIMUM_SIZE &&
+	   species->ngenomes <= species->genomes_size / 4){
+		neat_species_resize(species, species->genomes_size / 2);
+	}
+}
+
+bool neat_species_remove_genome_if_exists(struct neat_pop *p,
+					  struct neat_species *species,
 					  size_t genome_id)
 {
 	size_t i;
@@ -257,17 +456,11 @@ bool neat_species_remove_genome_if_exists(struct neat_species *species,
 	assert(species);
 
 	for(i = 0; i < species->ngenomes; i++){
-		if(species->genomes[i] != genome_id){
-			continue;
-		}
-
-		/* Put the last genome on this position
-		 * (this will do nothing if it already is the last one)
-		 */
-		species->genomes[i] = species->genomes[--species->ngenomes];
-		species->genomes[species->ngenomes] = SIZE_MAX;
+		if(species->genomes[i] == genome_id){
+			neat_species_remove_genome_at(p, species, i);
 
-		return true;
+			return true;
+		}
 	}
 
 	return false;
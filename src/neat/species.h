@@ -3,6 +3,7 @@
 #include <neat.h>
 
 #include "genome.h"
+#include "heap.h"
 
 /* Forward declare against cyclic dependency */
 struct neat_pop;
@@ -10,16 +11,55 @@ struct neat_pop;
 struct neat_species{
 	bool active;
 
+	/* Position in the list of species of the population, it changes when
+	 * other species are removed
+	 */
+	size_t id;
+	/* Position in the table of all species objects and the amount of times
+	 * the object was reused, together they make a handle that stays valid
+	 * for the life of the species
+	 */
+	size_t slot;
+	uint32_t version;
+
 	float avg_fitness, max_avg_fitness;
+	/* Sum of the fitness of all the members, it's kept up to date when the
+	 * fitness or the members change so the average doesn't need to visit
+	 * all of them
+	 */
+	double fitness_sum;
 	size_t generation, generation_with_max_fitness;
 	size_t times_stagnated;
 
+	/* Ids of the member genomes, the array grows and shrinks with the
+	 * amount of members so all the species together only use memory for
+	 * the population
+	 */
 	size_t *genomes;
-	size_t ngenomes;
+	size_t ngenomes, genomes_size;
+
+	/* The same genomes ordered on the fitness, the weakest heap only
+	 * contains the genomes that lived long enough to be replaced, the
+	 * positions in the heaps are stored in the organisms
+	 */
+	struct neat_heap fittest, weakest;
+
+	/* Position in the heap of species with the worst genomes of the
+	 * population, SIZE_MAX when there's no genome that can be replaced
+	 */
+	size_t worst_index;
+
+	/* Neighbours in the queue of dead species */
+	struct neat_species *dead_prev, *dead_next;
+
+	/* Next species object that can be reused after this one was removed */
+	struct neat_species *next_free;
 };
 
-struct neat_species *neat_species_create(struct neat_config config);
+struct neat_species *neat_species_create(struct neat_pop *p);
 void neat_species_destroy(struct neat_species *species);
+/* Start over as a new empty species, the allocated memory is kept */
+void neat_species_reset(struct neat_species *species);
 
 float neat_species_get_adjusted_fitness(struct neat_species *species,
 					float fitness);
@@ -27,22 +67,58 @@ float neat_species_update_average_fitness(struct neat_pop *p,
 					  struct neat_species *species);
 void neat_species_increase_generation(struct neat_species *species);
 
-/* Disable the species based on the number of stagnations and on weakness of
- * the species (amount of genomes)
+/* Check if the species should be disabled based on the number of stagnations
+ * and on weakness of the species (amount of genomes), the population disables
+ * it so its genomes get replaced first
  */
 bool neat_species_cull(struct neat_pop *p, struct neat_species *species);
 
+/* Select the genome with the highest fitness */
 size_t neat_species_select_genitor(struct neat_pop *p,
 				   struct neat_species *species);
 
+/* Select the genome with the second highest fitness */
 size_t neat_species_select_second_genitor(struct neat_pop *p,
 					  struct neat_species *species);
 
+/* Select the best genome out of a random sample of the members, a bigger size
+ * makes it more likely a good one is chosen
+ */
+size_t neat_species_select_tournament(struct neat_pop *p,
+				      struct neat_species *species,
+				      size_t size);
+
+/* Select the genome with the lowest fitness that lived longer than the
+ * minimum amount of ticks
+ *
+ * return SIZE_MAX if there is none
+ */
+size_t neat_species_select_weakest(struct neat_species *species);
+
+/* Add or remove the member from the genomes that can be replaced after its
+ * time alive changed
+ */
+void neat_species_update_eligibility(struct neat_pop *p,
+				     struct neat_species *species,
+				     size_t genome_id);
+
+/* Restore the order after the fitness of one of the members changed */
+void neat_species_update_fitness(struct neat_pop *p,
+				 struct neat_species *species,
+				 size_t genome_id);
+
 size_t neat_species_get_representant(struct neat_species *species);
 
-void neat_species_add_genome(struct neat_species *species,
+/* Add the genome as the last one, it shouldn't be in the species already */
+void neat_species_add_genome(struct neat_pop *p,
+			     struct neat_species *species,
 			     size_t genome_id);
-bool neat_species_remove_genome_if_exists(struct neat_species *species,
+/* Remove the genome at the index, the last genome is moved to its place */
+void neat_species_remove_genome_at(struct neat_pop *p,
+				   struct neat_species *species,
+				   size_t index);
+bool neat_species_remove_genome_if_exists(struct neat_pop *p,
+					  struct neat_species *species,
 					  size_t genome_id);
 bool neat_species_contains_genome(struct neat_species *species,
 				  size_t genome_id);
@@ -0,0 +1,173 @@
+#include "stream.h"
+
+#include <string.h>
+#include <assert.h>
+
+size_t neat_write_reserve(struct neat_writer *w, size_t size)
+{
+	size_t new_size;
+
+	if(w->grow && w->size - w->pos < size){
+		/* Doubling keeps the amount of copies linear */
+		new_size = w->size * 2;
+		if(new_size < w->pos + size){
+			new_size = w->pos + size;
+		}
+		w->buffer = realloc(w->buffer, new_size);
+		assert(w->buffer);
+		w->size = new_size;
+	}
+
+	return w->pos < w->size ? w->size - w->pos : 0;
+}
+
+void neat_write_byte(struct neat_writer *w, unsigned char byte)
+{
+	if(w->grow){
+		neat_write_reserve(w, 1);
+	}
+	if(w->pos < w->size){
+		w->buffer[w->pos] = byte;
+	}
+	w->pos++;
+}
+
+void neat_write_varint(struct neat_writer *w, uint64_t value)
+{
+	while(value >= 0x80){
+		neat_write_byte(w, (unsigned char)(value | 0x80));
+		value >>= 7;
+	}
+	neat_write_byte(w, (unsigned char)value);
+}
+
+void neat_write_fixed(struct neat_writer *w, uint64_t value, size_t bytes)
+{
+	size_t i;
+
+	assert(bytes <= 8);
+
+	for(i = 0; i < bytes; i++){
+		neat_write_byte(w, (unsigned char)(value >> (i * 8)));
+	}
+}
+
+void neat_write_float(struct neat_writer *w, float value)
+{
+	uint32_t bits;
+
+	memcpy(&bits, &value, sizeof(bits));
+	neat_write_fixed(w, bits, sizeof(bits));
+}
+
+void neat_write_double(struct neat_writer *w, double value)
+{
+	uint64_t bits;
+
+	memcpy(&bits, &value, sizeof(bits));
+	neat_write_fixed(w, bits, sizeof(bits));
+}
+
+void neat_write_bytes(struct neat_writer *w, const void *data, size_t size)
+{
+	assert(data || size == 0);
+
+	if(w->grow){
+		neat_write_reserve(w, size);
+	}
+	if(w->pos < w->size){
+		size_t n;
+
+		n = w->size - w->pos;
+		if(n > size){
+			n = size;
+		}
+		memcpy(w->buffer + w->pos, data, n);
+	}
+	w->pos += size;
+}
+
+unsigned char neat_read_byte(struct neat_reader *r)
+{
+	if(r->pos >= r->size){
+		r->error = true;
+		return 0;
+	}
+
+	return r->data[r->pos++];
+}
+
+uint64_t neat_read_varint(struct neat_reader *r)
+{
+	uint64_t value;
+	unsigned int shift;
+
+	value = 0;
+	for(shift = 0; shift < 64; shift += 7){
+		unsigned char byte;
+
+		byte = neat_read_byte(r);
+		value |= (uint64_t)(byte & 0x7f) << shift;
+		if(!(byte & 0x80)){
+			return value;
+		}
+	}
+
+	/* Too many bytes for a 64 bit value */
+	r->error = true;
+
+	return 0;
+}
+
+uint64_t neat_read_fixed(struct neat_reader *r, size_t bytes)
+{
+	uint64_t value;
+	size_t i;
+
+	assert(bytes <= 8);
+
+	value = 0;
+	for(i = 0; i < bytes; i++){
+		value |= (uint64_t)neat_read_byte(r) << (i * 8);
+	}
+
+	return value;
+}
+
+float neat_read_float(struct neat_reader *r)
+{
+	uint32_t bits;
+	float value;
+
+	bits = (uint32_t)neat_read_fixed(r, sizeof(bits));
+	memcpy(&value, &bits, sizeof(value));
+
+	return value;
+}
+
+double neat_read_double(struct neat_reader *r)
+{
+	uint64_t bits;
+	double value;
+
+	bits = neat_read_fixed(r, sizeof(bits));
+	memcpy(&value, &bits, sizeof(value));
+
+	return value;
+}
+
+const void *neat_read_bytes(struct neat_reader *r, size_t size)
+{
+	const void *data;
+
+	if(size > r->size - r->pos){
+		r->error = true;
+		r->pos = r->size;
+		return NULL;
+	}
+
+	data = r->data + r->pos;
+	r->pos += size;
+
+	return data;
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+/* Longest variable length integer in bytes */
+#define NEAT_VARINT_MAX_SIZE 10
+
+/* Writes binary data, it only writes while the buffer is big enough but keeps
+ * counting so the needed size is known, unless it grows the buffer
+ */
+struct neat_writer{
+	unsigned char *buffer;
+	size_t size, pos;
+	/* The buffer is allocated with malloc and reallocated when it's too
+	 * small, the caller frees it
+	 */
+	bool grow;
+};
+
+/* Reads binary data, reading past the end sets the error flag and returns
+ * zeroes
+ */
+struct neat_reader{
+	const unsigned char *data;
+	size_t size, pos;
+	bool error;
+};
+
+/* Make room for the bytes after the position when the writer grows
+ *
+ * return the amount of bytes that fit in the buffer after the position
+ */
+size_t neat_write_reserve(struct neat_writer *w, size_t size);
+void neat_write_byte(struct neat_writer *w, unsigned char byte);
+/* Variable length integer, 7 bits per byte with the high bit set when more
+ * bytes follow
+ */
+void neat_write_varint(struct neat_writer *w, uint64_t value);
+/* Fixed size little endian integer */
+void neat_write_fixed(struct neat_writer *w, uint64_t value, size_t bytes);
+void neat_write_float(struct neat_writer *w, float value);
+void neat_write_double(struct neat_writer *w, double value);
+void neat_write_bytes(struct neat_writer *w, const void *data, size_t size);
+
+unsigned char neat_read_byte(struct neat_reader *r);
+uint64_t neat_read_varint(struct neat_reader *r);
+uint64_t neat_read_fixed(struct neat_reader *r, size_t bytes);
+float neat_read_float(struct neat_reader *r);
+double neat_read_double(struct neat_reader *r);
+/* Skip the bytes
+ *
+ * return a pointer to them, NULL if there aren't enough left
+ */
+const void *neat_read_bytes(struct neat_reader *r, size_t size);
@@ -49,17 +49,6 @@ static float nn_activate(enum nn_activation activation, float input)
 	return 0.0f;
 }
 
-static float nn_rand(float start, float end)
-{
-	float range;
-
-	assert(start < end);
-
-	range = end - start;
-
-	return (float)rand() / (float)(RAND_MAX / range) + start;
-}
-
 static void nn_ffnet_set_pointers(struct nn_ffnet *net)
 {
 	assert(net);
@@ -152,19 +141,13 @@ static size_t nn_ffnet_total_activations(size_t hidden_count,
 	return hidden_count * hidden_layer_count + output_count;
 }
 
-struct nn_ffnet *nn_ffnet_create(size_t input_count,
-				 size_t hidden_count,
-				 size_t output_count,
-				 size_t hidden_layer_count)
+size_t nn_ffnet_get_size(size_t input_count,
+			 size_t hidden_count,
+			 size_t output_count,
+			 size_t hidden_layer_count)
 {
-	struct nn_ffnet *net;
-
 	size_t items_bytes, total_activs, total_neurons, total_weights;
 
-	assert(input_count > 0);
-	assert(output_count > 0);
-	assert(hidden_count > 0);
-
 	total_weights = nn_ffnet_total_weights(input_count,
 					       hidden_count,
 					       output_count,
@@ -179,22 +162,70 @@ struct nn_ffnet *nn_ffnet_create(size_t input_count,
 						  output_count,
 						  hidden_layer_count);
 
-	/* Allocate the struct with extra bytes behind it for the data */
+	/* The struct with extra bytes behind it for the data */
 	items_bytes = sizeof(float) * (total_weights + total_neurons);
-	/* Allocate the activations */
+	/* The activations */
 	items_bytes += sizeof(char) * total_activs;
 	assert(items_bytes > 0);
-	net = calloc(items_bytes + sizeof(struct nn_ffnet), 1);
-	assert(net);
+
+	return items_bytes + sizeof(struct nn_ffnet);
+}
+
+size_t nn_ffnet_get_weight_count(size_t input_count,
+				 size_t hidden_count,
+				 size_t output_count,
+				 size_t hidden_layer_count)
+{
+	return nn_ffnet_total_weights(input_count,
+				      hidden_count,
+				      output_count,
+				      hidden_layer_count);
+}
+
+size_t nn_ffnet_get_activation_count(size_t hidden_count,
+				     size_t output_count,
+				     size_t hidden_layer_count)
+{
+	return nn_ffnet_total_activations(hidden_count,
+					  output_count,
+					  hidden_layer_count);
+}
+
+struct nn_ffnet *nn_ffnet_init(void *memory,
+			       size_t input_count,
+			       size_t hidden_count,
+			       size_t output_count,
+			       size_t hidden_layer_count)
+{
+	struct nn_ffnet *net;
+
+	assert(memory);
+	assert(input_count > 0);
+	assert(output_count > 0);
+	assert(hidden_count > 0);
+
+	net = memory;
+	memset(net, 0, nn_ffnet_get_size(input_count,
+					 hidden_count,
+					 output_count,
+					 hidden_layer_count));
 
 	net->ninputs = input_count;
 	net->nhiddens = hidden_count;
 	net->noutputs = output_count;
 	net->nhidden_layers = hidden_layer_count;
 
-	net->nweights = total_weights;
-	net->nneurons = total_neurons;
-	net->nactivations = total_activs;
+	net->nweights = nn_ffnet_total_weights(input_count,
+					       hidden_count,
+					       output_count,
+					       hidden_layer_count);
+	net->nneurons = nn_ffnet_total_neurons(input_count,
+					       hidden_count,
+					       output_count,
+					       hidden_layer_count);
+	net->nactivations = nn_ffnet_total_activations(hidden_count,
+						       output_count,
+						       hidden_layer_count);
 
 	/* Default values */
 	net->bias = -1.0;
@@ -204,28 +235,63 @@ struct nn_ffnet *nn_ffnet_create(size_t input_count,
 	return net;
 }
 
-struct nn_ffnet *nn_ffnet_copy(struct nn_ffnet *net)
+struct nn_ffnet *nn_ffnet_create(size_t input_count,
+				 size_t hidden_count,
+				 size_t output_count,
+				 size_t hidden_layer_count)
 {
-	struct nn_ffnet *new;
-	size_t bytes, extra;
+	void *memory;
 
-	assert(net);
+	assert(input_count > 0);
+	assert(output_count > 0);
+	assert(hidden_count > 0);
 
-	extra = sizeof(float) * (net->nweights + net->nneurons);
-	extra += sizeof(char) * net->nactivations;
-	bytes = sizeof(struct nn_ffnet) + extra;
-	assert(bytes > sizeof(struct nn_ffnet));
+	memory = malloc(nn_ffnet_get_size(input_count,
+					  hidden_count,
+					  output_count,
+					  hidden_layer_count));
+	assert(memory);
+
+	return nn_ffnet_init(memory,
+			     input_count,
+			     hidden_count,
+			     output_count,
+			     hidden_layer_count);
+}
 
-	new = malloc(bytes);
-	assert(new);
+struct nn_ffnet *nn_ffnet_copy_into(void *memory, const struct nn_ffnet *net)
+{
+	struct nn_ffnet *new;
+
+	assert(memory);
+	assert(net);
 
-	memcpy(new, net, bytes);
+	new = memory;
+	memcpy(new, net, nn_ffnet_get_size(net->ninputs,
+					   net->nhiddens,
+					   net->noutputs,
+					   net->nhidden_layers));
 
 	nn_ffnet_set_pointers(new);
 
 	return new;
 }
 
+struct nn_ffnet *nn_ffnet_copy(struct nn_ffnet *net)
+{
+	void *memory;
+
+	assert(net);
+
+	memory = malloc(nn_ffnet_get_size(net->ninputs,
+					  net->nhiddens,
+					  net->noutputs,
+					  net->nhidden_layers));
+	assert(memory);
+
+	return nn_ffnet_copy_into(memory, net);
+}
+
 void nn_ffnet_destroy(struct nn_ffnet *net)
 {
 	assert(net);
@@ -233,23 +299,20 @@ void nn_ffnet_destroy(struct nn_ffnet *net)
 	free(net);
 }
 
-struct nn_ffnet *nn_ffnet_add_hidden_layer(struct nn_ffnet *net, float weight)
+void nn_ffnet_add_hidden_layer_into(struct nn_ffnet *new,
+				    const struct nn_ffnet *net,
+				    float weight)
 {
-	struct nn_ffnet *new;
 	size_t new_layer, nweights_per_neuron, noutput_weights;
 	float *new_weight_finish, *new_weight;
 
+	assert(new);
 	assert(net);
 	assert(net->nhiddens > 0);
-
-	/* Creating a new network is the easiest solution since all the pointers
-	 * will be put in the right position for us by default
-	 */
-	new = nn_ffnet_create(net->ninputs,
-			      net->nhiddens,
-			      net->noutputs,
-			      net->nhidden_layers + 1);
-	assert(new);
+	assert(new->ninputs == net->ninputs);
+	assert(new->nhiddens == net->nhiddens);
+	assert(new->noutputs == net->noutputs);
+	assert(new->nhidden_layers == net->nhidden_layers + 1);
 
 	/* ACTIVATIONS */
 	/* Copy the hidden activations */
@@ -277,9 +340,6 @@ struct nn_ffnet *nn_ffnet_add_hidden_layer(struct nn_ffnet *net, float weight)
 	       net->weight + net->nweights - noutput_weights,
 	       sizeof(float) * noutput_weights);
 
-	/* Destroy the old one */
-	nn_ffnet_destroy(net);
-
 	new_layer = new->nhidden_layers - 1;
 	/* Get the starting weight */
 	if(new_layer == 0){
@@ -304,6 +364,28 @@ struct nn_ffnet *nn_ffnet_add_hidden_layer(struct nn_ffnet *net, float weight)
 		 * node gets connected to the same one on the previous layer
 		 */
 	}while((new_weight += nweights_per_neuron + 1) < new_weight_finish);
+}
+
+struct nn_ffnet *nn_ffnet_add_hidden_layer(struct nn_ffnet *net, float weight)
+{
+	struct nn_ffnet *new;
+
+	assert(net);
+	assert(net->nhiddens > 0);
+
+	/* Creating a new network is the easiest solution since all the pointers
+	 * will be put in the right position for us by default
+	 */
+	new = nn_ffnet_create(net->ninputs,
+			      net->nhiddens,
+			      net->noutputs,
+			      net->nhidden_layers + 1);
+	assert(new);
+
+	nn_ffnet_add_hidden_layer_into(new, net, weight);
+
+	/* Destroy the old one */
+	nn_ffnet_destroy(net);
 
 	return new;
 }
@@ -345,35 +427,43 @@ void nn_ffnet_set_weights(struct nn_ffnet *net, float weight)
 	}
 }
 
-void nn_ffnet_randomize(struct nn_ffnet *net)
+void nn_ffnet_randomize(struct nn_ffnet *net, struct nn_rng *rng)
 {
-	size_t i;
-
 	assert(net);
+	assert(rng);
 
-	for(i = 0; i < net->nweights; i++){
-		net->weight[i] = nn_rand(-0.5, 0.5);
-	}
+	nn_rng_fill_uniform(rng, net->weight, net->nweights, -0.5f, 0.5f);
 }
 
 float *nn_ffnet_run(struct nn_ffnet *net, const float *inputs)
 {
-	float *input, *weight, *output, *ret;
-	char *activation;
+	assert(net);
+
+	return nn_ffnet_run_into(net, inputs, net->output);
+}
+
+float *nn_ffnet_run_into(const struct nn_ffnet *net,
+			 const float *inputs,
+			 float *neurons)
+{
+	float *input, *output, *ret;
+	const float *weight;
+	const char *activation;
 	size_t i, nweights;
 
 	assert(net);
+	assert(neurons);
 
 	/* Copy the inputs to the extra output memory space so we don't have
 	 * to make a special case for the input layer, it will look like this:
 	 * [ **struct**, weight.. , input.., output.., **delta** ]
 	 */
-	input = net->output;
+	input = neurons;
 	memcpy(input, inputs, sizeof(float) * net->ninputs);
 
 	/* Calculate hidden layers */
 	weight = net->weight;
-	output = net->output + net->ninputs;
+	output = neurons + net->ninputs;
 	activation = net->activation;
 	for(i = 0; i < net->nhidden_layers; i++){
 		size_t j, nweights;
@@ -429,7 +519,7 @@ float *nn_ffnet_run(struct nn_ffnet *net, const float *inputs)
 	}
 
 	assert(weight - net->weight == (int)net->nweights);
-	assert(output - net->output == (int)net->nneurons);
+	assert(output - neurons == (int)net->nneurons);
 
 	return ret;
 }
@@ -0,0 +1,288 @@
+#include <nn.h>
+
+#include <math.h>
+#include <assert.h>
+
+/* Amount of generators that are run side by side by the bulk functions, their
+ * states are stored as separate arrays so the compiler can vectorize them
+ */
+#define NN_RNG_LANES 8
+
+/* Below this amount the lanes are not worth seeding */
+#define NN_RNG_BULK_MINIMUM (NN_RNG_LANES * 8)
+
+/* Amount of floats generated on the stack at a time for the gaussian */
+#define NN_RNG_GAUSSIAN_CHUNK 256
+
+/* xoshiro128** by David Blackman and Sebastiano Vigna, the state is 4 32-bit
+ * words so it doesn't need a 64-bit type
+ */
+
+static uint32_t nn_rng_rotl(uint32_t x, int k)
+{
+	return (x << k) | (x >> (32 - k));
+}
+
+/* Used to expand a seed into the full state, it makes sure the state can
+ * never be all zeroes for different seeds
+ */
+static uint32_t nn_rng_splitmix(uint32_t *x)
+{
+	uint32_t z;
+
+	z = (*x += 0x9e3779b9u);
+	z = (z ^ (z >> 16)) * 0x85ebca6bu;
+	z = (z ^ (z >> 13)) * 0xc2b2ae35u;
+
+	return z ^ (z >> 16);
+}
+
+void nn_rng_seed(struct nn_rng *rng, unsigned long seed)
+{
+	uint32_t x;
+	size_t i;
+
+	assert(rng);
+
+	/* Fold the upper half of the seed in if longs are 64 bits */
+	x = (uint32_t)seed ^ (uint32_t)((seed >> 16) >> 16);
+	for(i = 0; i < 4; i++){
+		rng->state[i] = nn_rng_splitmix(&x);
+	}
+}
+
+uint32_t nn_rng_next(struct nn_rng *rng)
+{
+	uint32_t *s, result, t;
+
+	assert(rng);
+
+	s = rng->state;
+	result = nn_rng_rotl(s[1] * 5, 7) * 9;
+	t = s[1] << 9;
+
+	s[2] ^= s[0];
+	s[3] ^= s[1];
+	s[1] ^= s[2];
+	s[0] ^= s[3];
+
+	s[2] ^= t;
+	s[3] = nn_rng_rotl(s[3], 11);
+
+	return result;
+}
+
+float nn_rng_float(struct nn_rng *rng)
+{
+	/* Use the upper 24 bits, which is exactly the precision of a float */
+	return (float)(nn_rng_next(rng) >> 8) * (1.0f / 16777216.0f);
+}
+
+float nn_rng_uniform(struct nn_rng *rng, float start, float end)
+{
+	assert(start < end);
+
+	return start + nn_rng_float(rng) * (end - start);
+}
+
+size_t nn_rng_index(struct nn_rng *rng, size_t count)
+{
+	assert(count > 0);
+
+	/* Map the random number on the range with a multiplication instead of
+	 * a modulo, this is faster and doesn't favor the lower numbers
+	 */
+	if(count <= 0xffffffffu){
+		return (size_t)(((uint64_t)nn_rng_next(rng) * count) >> 32);
+	}
+
+	return (((size_t)nn_rng_next(rng) << 16 << 16) | nn_rng_next(rng)) %
+		count;
+}
+
+void nn_rng_jump(struct nn_rng *rng)
+{
+	static const uint32_t jump[] = {
+		0x8764000bu, 0xf542d2d3u, 0x6fa035c3u, 0x77f2db5bu
+	};
+
+	uint32_t s[4];
+	size_t i;
+	int b;
+
+	assert(rng);
+
+	s[0] = s[1] = s[2] = s[3] = 0;
+	for(i = 0; i < 4; i++){
+		for(b = 0; b < 32; b++){
+			if(jump[i] & (uint32_t)1 << b){
+				s[0] ^= rng->state[0];
+				s[1] ^= rng->state[1];
+				s[2] ^= rng->state[2];
+				s[3] ^= rng->state[3];
+			}
+			nn_rng_next(rng);
+		}
+	}
+
+	rng->state[0] = s[0];
+	rng->state[1] = s[1];
+	rng->state[2] = s[2];
+	rng->state[3] = s[3];
+}
+
+struct nn_rng nn_rng_split(struct nn_rng *rng)
+{
+	struct nn_rng stream;
+
+	assert(rng);
+
+	/* The new stream continues where the original was and the original
+	 * jumps 2^64 numbers ahead so they never overlap
+	 */
+	stream = *rng;
+	nn_rng_jump(rng);
+
+	return stream;
+}
+
+struct nn_rng nn_rng_derive(const struct nn_rng *rng, unsigned long id)
+{
+	struct nn_rng stream;
+	uint32_t x;
+	size_t i;
+
+	assert(rng);
+
+	/* Mix the id into every word of the state, the original is not
+	 * changed so the same id always gives the same stream
+	 */
+	x = (uint32_t)id ^ (uint32_t)((id >> 16) >> 16);
+	for(i = 0; i < 4; i++){
+		stream.state[i] = rng->state[i] ^ nn_rng_splitmix(&x);
+	}
+
+	/* Make sure the state is never all zeroes */
+	if((stream.state[0] | stream.state[1] |
+	    stream.state[2] | stream.state[3]) == 0){
+		stream.state[0] = 1;
+	}
+
+	return stream;
+}
+
+static void nn_rng_fill_uniform_lanes(struct nn_rng *rng,
+				      float *out,
+				      size_t count,
+				      float start,
+				      float end)
+{
+	uint32_t s0[NN_RNG_LANES], s1[NN_RNG_LANES];
+	uint32_t s2[NN_RNG_LANES], s3[NN_RNG_LANES];
+	float block[NN_RNG_LANES], scale;
+	size_t i, j;
+
+	/* Every lane gets its own state drawn from the generator */
+	for(j = 0; j < NN_RNG_LANES; j++){
+		s0[j] = nn_rng_next(rng);
+		s1[j] = nn_rng_next(rng);
+		s2[j] = nn_rng_next(rng);
+		s3[j] = nn_rng_next(rng) | 1;
+	}
+
+	scale = (end - start) * (1.0f / 16777216.0f);
+
+	for(i = 0; i < count; i += NN_RNG_LANES){
+		/* The same xoshiro128** step as nn_rng_next, but for all the
+		 * lanes at once, the multiplications are written as shifts
+		 */
+		for(j = 0; j < NN_RNG_LANES; j++){
+			uint32_t result, t;
+
+			result = (s1[j] << 2) + s1[j];
+			result = (result << 7) | (result >> 25);
+			result = (result << 3) + result;
+			t = s1[j] << 9;
+
+			s2[j] ^= s0[j];
+			s3[j] ^= s1[j];
+			s1[j] ^= s2[j];
+			s0[j] ^= s3[j];
+
+			s2[j] ^= t;
+			s3[j] = (s3[j] << 11) | (s3[j] >> 21);
+
+			block[j] = start + (float)(int32_t)(result >> 8) * scale;
+		}
+
+		if(count - i >= NN_RNG_LANES){
+			for(j = 0; j < NN_RNG_LANES; j++){
+				out[i + j] = block[j];
+			}
+		}else{
+			for(j = 0; j < count - i; j++){
+				out[i + j] = block[j];
+			}
+		}
+	}
+}
+
+void nn_rng_fill_uniform(struct nn_rng *rng,
+			 float *out,
+			 size_t count,
+			 float start,
+			 float end)
+{
+	size_t i;
+
+	assert(rng);
+	assert(out || count == 0);
+	assert(start < end);
+
+	if(count >= NN_RNG_BULK_MINIMUM){
+		nn_rng_fill_uniform_lanes(rng, out, count, start, end);
+		return;
+	}
+
+	for(i = 0; i < count; i++){
+		out[i] = nn_rng_uniform(rng, start, end);
+	}
+}
+
+void nn_rng_fill_gaussian(struct nn_rng *rng,
+			  float *out,
+			  size_t count,
+			  float mean,
+			  float deviation)
+{
+	float uniform[NN_RNG_GAUSSIAN_CHUNK];
+	size_t i, j, n;
+
+	assert(rng);
+	assert(out || count == 0);
+
+	for(i = 0; i < count; i += n){
+		n = count - i;
+		if(n > NN_RNG_GAUSSIAN_CHUNK){
+			n = NN_RNG_GAUSSIAN_CHUNK;
+		}
+
+		/* Box-Muller needs pairs of uniform numbers, the first one in
+		 * (0, 1] so the logarithm is defined
+		 */
+		nn_rng_fill_uniform(rng, uniform, (n + 1) & ~(size_t)1, 0, 1);
+
+		for(j = 0; j < n; j += 2){
+			float radius, angle;
+
+			radius = sqrt(-2.0 * log(1.0f - uniform[j]));
+			angle = 2.0 * 3.14159265358979 * uniform[j + 1];
+
+			out[i + j] = mean + deviation * radius * cos(angle);
+			if(j + 1 < n){
+				out[i + j + 1] = mean +
+					deviation * radius * sin(angle);
+			}
+		}
+	}
+}
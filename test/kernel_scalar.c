@@ -0,0 +1,12 @@
+/* The kernels of the library built without SSE2, so the tests can compare the
+ * vectorized versions in the library with the scalar fallback
+ */
+#undef __SSE2__
+
+#define neat_kernel_mask_innovations neat_kernel_scalar_mask_innovations
+#define neat_kernel_set_innovations neat_kernel_scalar_set_innovations
+#define neat_kernel_blend_matching neat_kernel_scalar_blend_matching
+#define neat_kernel_matching_difference \
+	neat_kernel_scalar_matching_difference
+
+#include "../src/neat/kernel.c"
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <stdlib.h>
+
+/* The scalar fallbacks of the kernels in src/neat/kernel.h */
+
+size_t neat_kernel_scalar_mask_innovations(int *innov,
+					   const float *weight,
+					   size_t count);
+size_t neat_kernel_scalar_set_innovations(int *innov,
+					  const float *weight,
+					  size_t count,
+					  int innovation);
+size_t neat_kernel_scalar_blend_matching(float *child,
+					 int *child_innov,
+					 const float *weight1,
+					 const float *weight2,
+					 const int *innov1,
+					 const int *innov2,
+					 size_t count);
+size_t neat_kernel_scalar_matching_difference(const float *weight1,
+					      const float *weight2,
+					      const int *innov1,
+					      const int *innov2,
+					      size_t count,
+					      float *weight_sum);
@@ -10,6 +10,10 @@
 
 #include "greatest.h"
 
+#include "../src/neat/population.h"
+#include "../src/neat/kernel.h"
+#include "kernel_scalar.h"
+
 const float xor_inputs[4][2] = {
 	{0.0f, 0.0f},
 	{0.0f, 1.0f},
@@ -18,103 +22,1762 @@ const float xor_inputs[4][2] = {
 };
 const float xor_outputs[4] = {0.0f, 1.0f, 1.0f, 0.0f};
 
-TEST neat_create_and_destroy(void)
+static float neat_xor_fitness(neat_t neat, size_t genome_id)
+{
+	float error;
+	int k;
+
+	error = 0.0f;
+	for(k = 0; k < 4; k++){
+		const float *results;
+
+		results = neat_run(neat, genome_id, xor_inputs[k]);
+		error += fabs(results[0] - xor_outputs[k]);
+	}
+
+	return (4.0 - error) / 4.0;
+}
+
+static void neat_xor_epoch(neat_t neat, size_t population_size)
+{
+	size_t i;
+
+	for(i = 0; i < population_size; i++){
+		neat_set_fitness(neat, i, neat_xor_fitness(neat, i));
+	}
+
+	neat_tick(neat);
+	neat_epoch(neat, NULL);
+}
+
+/* Config of the xor populations the tests evolve, a test changes the fields
+ * it's about on top of it
+ */
+static struct neat_config neat_xor_config(size_t population_size,
+					  unsigned long seed)
+{
+	struct neat_config config;
+
+	config = neat_get_default_config();
+	config.network_inputs = 2;
+	config.network_outputs = 1;
+	config.network_hidden_nodes = 2;
+	config.population_size = population_size;
+	config.genome_minimum_ticks_alive = 1;
+	config.minimum_time_before_replacement = 1;
+	config.seed = seed;
+
+	return config;
+}
+
+/* Create the population and evolve it on xor for the amount of epochs
+ *
+ * return NULL if the population couldn't be created
+ */
+static neat_t neat_xor_create(struct neat_config config, size_t epochs)
+{
+	neat_t neat;
+	size_t i;
+
+	neat = neat_create(config);
+	if(!neat){
+		return NULL;
+	}
+	for(i = 0; i < epochs; i++){
+		neat_xor_epoch(neat, config.population_size);
+	}
+
+	return neat;
+}
+
+TEST neat_create_and_destroy(void)
+{
+	struct neat_config config;
+	neat_t neat;
+
+	config = neat_get_default_config();
+	config.network_inputs = 1;
+	config.network_outputs = 1;
+	config.network_hidden_nodes = 1;
+	config.population_size = 1;
+	config.minimum_time_before_replacement = 1;
+
+	neat = neat_create(config);
+	ASSERT(neat);
+
+	neat_destroy(neat);
+	PASS();
+}
+
+TEST neat_xor(void)
+{
+	neat_t neat;
+	struct neat_config config;
+	size_t i;
+	float max_fitness;
+
+	config = neat_get_default_config();
+	config.network_inputs = 2;
+	config.network_outputs = 1;
+	config.network_hidden_nodes = 2;
+
+	config.population_size = 300;
+	/* Genomes don't have to survive for very long because their survival
+	 * state is determined in 1 tick
+	 */
+	config.genome_minimum_ticks_alive = 1;
+	config.minimum_time_before_replacement = 1;
+
+	/* We only rarely want to add another nouron because a XOR network
+	 * should work just fine with 1 hidden layer
+	 */
+	config.genome_add_neuron_mutation_probability = 0.01;
+
+	neat = neat_create(config);
+	ASSERT(neat);
+
+	max_fitness = 0.0f;
+
+	/* Epochs */
+	for(i = 0; i < 10000; i++){
+		size_t j;
+
+		/* Organisms */
+		for(j = 0; j < config.population_size; j++){
+			float fitness, error;
+			int k;
+
+			/* XOR sets */
+			error = 0.0f;
+			for(k = 0; k < 4; k++){
+				const float *results;
+
+				results = neat_run(neat, j, xor_inputs[k]);
+				ASSERT(results);
+
+				error += fabs(results[0] - xor_outputs[k]);
+			}
+
+			fitness = (4.0 - error) / 4.0;
+
+			if(fitness > 0.9){
+				char message[512];
+
+				neat_destroy(neat);
+
+				sprintf(message,
+					"Found solution after %d iterations",
+					(int)i);
+				
+				PASSm(message);
+			}
+
+			if(fitness > max_fitness){
+				max_fitness = fitness;
+			}
+
+			neat_set_fitness(neat, j, fitness);
+
+			neat_increase_time_alive(neat, j);
+		}
+
+		neat_epoch(neat, NULL);
+	}
+
+	neat_destroy(neat);
+	printf("Iterations: %d, fitness: %g\n", (int)i, max_fitness);
+	PASSm("A mutation that solved the xor problem did not occur");
+}
+
+static bool nn_ffnet_equal(const struct nn_ffnet *n1, const struct nn_ffnet *n2)
+{
+	if(n1->nweights != n2->nweights ||
+	   n1->nactivations != n2->nactivations){
+		return false;
+	}
+
+	return memcmp(n1->weight, n2->weight,
+		      sizeof(float) * n1->nweights) == 0 &&
+		memcmp(n1->activation, n2->activation, n1->nactivations) == 0;
+}
+
+TEST neat_seed_reproducible(void)
+{
+	neat_t neat1, neat2, neat3;
+	struct neat_config config;
+	size_t i;
+	bool differs;
+
+	config = neat_xor_config(50, 1234);
+
+	neat1 = neat_create(config);
+	ASSERT(neat1);
+	neat2 = neat_create(config);
+	ASSERT(neat2);
+	config.seed++;
+	neat3 = neat_create(config);
+	ASSERT(neat3);
+
+	for(i = 0; i < 500; i++){
+		neat_xor_epoch(neat1, config.population_size);
+		neat_xor_epoch(neat2, config.population_size);
+		neat_xor_epoch(neat3, config.population_size);
+	}
+
+	/* Another seed must evolve other networks */
+	differs = false;
+	for(i = 0; i < config.population_size; i++){
+		differs |= !nn_ffnet_equal(neat_get_network(neat1, i),
+					   neat_get_network(neat3, i));
+	}
+	ASSERT(differs);
+
+	/* Both populations must have evolved exactly the same */
+	ASSERT_EQ(neat_get_num_species(neat1), neat_get_num_species(neat2));
+	for(i = 0; i < config.population_size; i++){
+		const struct nn_ffnet *n1, *n2;
+		size_t j;
+
+		n1 = neat_get_network(neat1, i);
+		n2 = neat_get_network(neat2, i);
+		ASSERT_EQ(n1->nweights, n2->nweights);
+		for(j = 0; j < n1->nweights; j++){
+			ASSERT_EQ_FMT(n1->weight[j], n2->weight[j], "%g");
+		}
+	}
+
+	neat_destroy(neat1);
+	neat_destroy(neat2);
+	neat_destroy(neat3);
+	PASS();
+}
+
+TEST neat_genome_info_counts(void)
+{
+	neat_t neat;
+	struct neat_config config;
+	size_t i;
+
+	config = neat_xor_config(50, 42);
+	config.network_hidden_nodes = 3;
+
+	neat = neat_xor_create(config, 300);
+	ASSERT(neat);
+
+	/* The counts must match a scan of the networks */
+	for(i = 0; i < config.population_size; i++){
+		const struct nn_ffnet *n;
+		struct neat_genome_info info;
+		size_t layer, j, start, used_weights, used_activs;
+
+		n = neat_get_network(neat, i);
+		neat_get_genome_info(neat, i, &info);
+		ASSERT_EQ(n->nweights, info.nweights);
+		ASSERT_EQ(n->nactivations, info.nactivations);
+		ASSERT_EQ(n->nhidden_layers, info.nhidden_layers);
+
+		start = 0;
+		used_weights = 0;
+		used_activs = 0;
+		for(layer = 0; layer <= n->nhidden_layers; layer++){
+			size_t end, nweights, nactivs;
+
+			if(layer == n->nhidden_layers){
+				end = n->nweights;
+			}else if(layer == 0){
+				end = (n->ninputs + 1) * n->nhiddens;
+			}else{
+				end = start + (n->nhiddens + 1) * n->nhiddens;
+			}
+
+			nweights = 0;
+			for(j = start; j < end; j++){
+				nweights += n->weight[j] != 0.0f;
+			}
+			start = end;
+
+			nactivs = 0;
+			for(j = layer * n->nhiddens; j < n->nactivations; j++){
+				if(layer < n->nhidden_layers &&
+				   j >= (layer + 1) * n->nhiddens){
+					break;
+				}
+				nactivs += n->activation[j] !=
+					NN_ACTIVATION_PASSTHROUGH;
+			}
+
+			ASSERT_EQ(nweights, info.layer_weights[layer]);
+			ASSERT_EQ(nactivs, info.layer_activations[layer]);
+			used_weights += nweights;
+			used_activs += nactivs;
+		}
+		ASSERT_EQ(used_weights, info.used_weights);
+		ASSERT_EQ(used_activs, info.used_activations);
+	}
+
+	neat_destroy(neat);
+	PASS();
+}
+
+TEST neat_tick_matches_time_alive(void)
+{
+	neat_t neat1, neat2;
+	struct neat_pop *p1, *p2;
+	struct neat_config config;
+	size_t i, j;
+
+	config = neat_xor_config(50, 4321);
+	config.genome_minimum_ticks_alive = 5;
+
+	neat1 = neat_create(config);
+	ASSERT(neat1);
+	neat2 = neat_create(config);
+	ASSERT(neat2);
+
+	/* Aging the whole population at once must be the same as aging every
+	 * genome by itself
+	 */
+	p1 = neat1;
+	p2 = neat2;
+	for(i = 0; i < 300; i++){
+		neat_xor_epoch(neat1, config.population_size);
+
+		for(j = 0; j < config.population_size; j++){
+			neat_set_fitness(neat2, j, neat_xor_fitness(neat2, j));
+			neat_increase_time_alive(neat2, j);
+		}
+		neat_epoch(neat2, NULL);
+
+		/* Every genome must have the same age and be replaceable at
+		 * the same time
+		 */
+		ASSERT_EQ(0, p2->clock);
+		for(j = 0; j < config.population_size; j++){
+			ASSERT_EQ(neat_organism_age(p1, j),
+				  p2->organisms[j].time_alive);
+			ASSERT_EQ(p1->organisms[j].weakest_index == SIZE_MAX,
+				  p2->organisms[j].weakest_index == SIZE_MAX);
+		}
+	}
+
+	ASSERT_EQ(neat_get_num_species(neat1), neat_get_num_species(neat2));
+	for(i = 0; i < config.population_size; i++){
+		ASSERT(nn_ffnet_equal(neat_get_network(neat1, i),
+				      neat_get_network(neat2, i)));
+	}
+
+	neat_destroy(neat1);
+	neat_destroy(neat2);
+	PASS();
+}
+
+TEST neat_tick_passes_birth_queue(void)
+{
+	neat_t neat, loaded;
+	struct neat_pop *p;
+	struct neat_config config;
+	FILE *file;
+	size_t i;
+
+	config = neat_xor_config(20, 9753);
+	config.genome_minimum_ticks_alive = 3;
+
+	neat = neat_create(config);
+	ASSERT(neat);
+
+	/* The genomes are born on the same tick, the extra tick makes the
+	 * last one old enough while the first ones are still young
+	 */
+	neat_increase_time_alive(neat, 19);
+	for(i = 0; i < 3; i++){
+		neat_tick(neat);
+	}
+
+	p = neat;
+	ASSERT_EQ(4, neat_organism_age(p, 19));
+	ASSERT(p->organisms[19].weakest_index != SIZE_MAX);
+	ASSERT_EQ(SIZE_MAX, p->organisms[0].weakest_index);
+
+	/* The same must hold when the population is loaded in between */
+	neat_destroy(neat);
+	neat = neat_create(config);
+	ASSERT(neat);
+	neat_increase_time_alive(neat, 19);
+
+	file = tmpfile();
+	ASSERT(file);
+	ASSERT(neat_save(neat, file, false));
+	rewind(file);
+	loaded = neat_load(file);
+	ASSERT(loaded);
+	fclose(file);
+
+	for(i = 0; i < 3; i++){
+		neat_tick(loaded);
+	}
+
+	p = loaded;
+	ASSERT(p->organisms[19].weakest_index != SIZE_MAX);
+	ASSERT_EQ(SIZE_MAX, p->organisms[0].weakest_index);
+
+	neat_destroy(neat);
+	neat_destroy(loaded);
+	PASS();
+}
+
+TEST neat_shared_genomes_stay_separate(void)
+{
+	neat_t neat;
+	struct neat_config config;
+	const struct nn_ffnet *net;
+	const float *outputs;
+	float output, *weights;
+	size_t i, j, epoch, first, second, replaced;
+
+	config = neat_xor_config(50, 8642);
+
+	neat = neat_create(config);
+	ASSERT(neat);
+
+	/* Evolve until two organisms share the network of a cloned genome */
+	first = second = SIZE_MAX;
+	for(epoch = 0; epoch < 1000 && first == SIZE_MAX; epoch++){
+		neat_xor_epoch(neat, config.population_size);
+
+		for(i = 0; i < config.population_size && first == SIZE_MAX;
+		    i++){
+			for(j = i + 1; j < config.population_size; j++){
+				if(neat_get_network(neat, i) ==
+				   neat_get_network(neat, j)){
+					first = i;
+					second = j;
+					break;
+				}
+			}
+		}
+	}
+	ASSERT(first != SIZE_MAX);
+
+	/* Running the sibling doesn't change the outputs of the first */
+	outputs = neat_run(neat, first, xor_inputs[1]);
+	output = outputs[0];
+	neat_run(neat, second, xor_inputs[0]);
+	ASSERT_EQ(output, outputs[0]);
+
+	/* Replacing one of them leaves the network of the other alone */
+	net = neat_get_network(neat, second);
+	weights = malloc(sizeof(float) * net->nweights);
+	ASSERT(weights);
+	memcpy(weights, net->weight, sizeof(float) * net->nweights);
+	replaced = SIZE_MAX;
+	for(epoch = 0; epoch < 1000; epoch++){
+		for(i = 0; i < config.population_size; i++){
+			neat_set_fitness(neat, i, i == first ? 0.0f : 1.0f);
+		}
+		neat_tick(neat);
+		if(neat_epoch(neat, &replaced) && replaced == first){
+			break;
+		}
+		ASSERT(replaced != second);
+	}
+	ASSERT_EQ(first, replaced);
+	ASSERT_EQ(net, neat_get_network(neat, second));
+	ASSERT_EQ(0, memcmp(weights, net->weight,
+			    sizeof(float) * net->nweights));
+
+	free(weights);
+	neat_destroy(neat);
+	PASS();
+}
+
+TEST neat_save_load_continues(void)
+{
+	neat_t neat1, neat2;
+	struct neat_config config;
+	struct neat_pop *p1, *p2;
+	FILE *file, *truncated;
+	void *data;
+	long full_size, compressed_size;
+	float fitness;
+	size_t i, nremembered;
+
+	config = neat_xor_config(50, 2468);
+	config.genome_minimum_ticks_alive = 5;
+	config.fitness_memo_size = 64;
+
+	neat1 = neat_xor_create(config, 200);
+	ASSERT(neat1);
+
+	file = tmpfile();
+	ASSERT(file);
+	ASSERT(neat_save(neat1, file, false));
+	full_size = ftell(file);
+
+	/* A truncated save must be rejected */
+	truncated = tmpfile();
+	ASSERT(truncated);
+	data = malloc(full_size / 2);
+	ASSERT(data);
+	rewind(file);
+	ASSERT_EQ(full_size / 2, (long)fread(data, 1, full_size / 2, file));
+	fwrite(data, 1, full_size / 2, truncated);
+	rewind(truncated);
+	ASSERT_EQ(NULL, neat_load(truncated));
+	free(data);
+	fclose(truncated);
+	fclose(file);
+
+	file = tmpfile();
+	ASSERT(file);
+	ASSERT(neat_save(neat1, file, true));
+	compressed_size = ftell(file);
+	ASSERT(compressed_size < full_size);
+	rewind(file);
+	neat2 = neat_load(file);
+	ASSERT(neat2);
+	fclose(file);
+
+	/* Every organism must come back with its network, fitness, age and
+	 * species
+	 */
+	p1 = neat1;
+	p2 = neat2;
+	ASSERT_EQ(p1->clock, p2->clock);
+	for(i = 0; i < config.population_size; i++){
+		ASSERT(nn_ffnet_equal(neat_get_network(neat1, i),
+				      neat_get_network(neat2, i)));
+		ASSERT_EQ(neat_get_fingerprint(neat1, i),
+			  neat_get_fingerprint(neat2, i));
+		ASSERT_EQ(p1->organisms[i].fitness, p2->organisms[i].fitness);
+		ASSERT_EQ(neat_organism_age(p1, i), neat_organism_age(p2, i));
+		ASSERT_EQ(p1->organisms[i].time_alive,
+			  p2->organisms[i].time_alive);
+		ASSERT_EQ(neat_get_species_id(neat1, i),
+			  neat_get_species_id(neat2, i));
+		ASSERT_EQ(p1->organisms[i].weakest_index == SIZE_MAX,
+			  p2->organisms[i].weakest_index == SIZE_MAX);
+	}
+
+	/* The remembered fitnesses are not saved */
+	nremembered = 0;
+	for(i = 0; i < config.population_size; i++){
+		nremembered += neat_get_memoized_fitness(neat1, i, &fitness);
+		ASSERT_FALSE(neat_get_memoized_fitness(neat2, i, &fitness));
+	}
+	ASSERT(nremembered > 0);
+
+	/* The loaded population must continue exactly like the original */
+	for(i = 0; i < 200; i++){
+		neat_xor_epoch(neat1, config.population_size);
+		neat_xor_epoch(neat2, config.population_size);
+	}
+
+	ASSERT_EQ(neat_get_num_species(neat1), neat_get_num_species(neat2));
+	for(i = 0; i < config.population_size; i++){
+		ASSERT(nn_ffnet_equal(neat_get_network(neat1, i),
+				      neat_get_network(neat2, i)));
+	}
+
+	neat_destroy(neat1);
+	neat_destroy(neat2);
+	PASS();
+}
+
+TEST neat_load_checks_dead_species(void)
+{
+	neat_t neat, loaded;
+	struct neat_config config;
+	FILE *file;
+	unsigned char *data;
+	long size;
+	size_t i, epoch, dead, alive;
+
+	config = neat_xor_config(50, 77);
+	config.species_stagnation_treshold = 50;
+	config.species_stagnations_allowed = 0;
+
+	neat = neat_create(config);
+	ASSERT(neat);
+
+	/* Run until a species is dead and still waiting in the queue */
+	dead = alive = SIZE_MAX;
+	for(epoch = 0; epoch < 1000 && dead == SIZE_MAX; epoch++){
+		neat_xor_epoch(neat, config.population_size);
+		for(i = 0; i < neat_get_num_species(neat); i++){
+			if(neat_get_species_is_alive(neat, i)){
+				alive = i;
+			}else{
+				dead = i;
+			}
+		}
+	}
+	/* The ids are written as single bytes when they're this small */
+	ASSERT(dead != SIZE_MAX && alive < 128);
+
+	file = tmpfile();
+	ASSERT(file);
+	ASSERT(neat_save(neat, file, false));
+	size = ftell(file);
+	rewind(file);
+	data = malloc(size);
+	ASSERT(data);
+	ASSERT_EQ(size, (long)fread(data, 1, size, file));
+	fclose(file);
+
+	/* The last byte is the last species in the dead queue, queueing an
+	 * active species instead must be rejected
+	 */
+	data[size - 1] = (unsigned char)alive;
+	file = tmpfile();
+	ASSERT(file);
+	ASSERT_EQ(size, (long)fwrite(data, 1, size, file));
+	rewind(file);
+	loaded = neat_load(file);
+	fclose(file);
+	free(data);
+	if(loaded){
+		neat_destroy(loaded);
+	}
+	ASSERT_EQ(NULL, loaded);
+
+	neat_destroy(neat);
+	PASS();
+}
+
+/* Write the value the way the population stores sizes and counts */
+static size_t neat_write_test_varint(unsigned char *buffer, size_t value)
+{
+	size_t size;
+
+	for(size = 0; value >= 0x80; size++){
+		buffer[size] = (unsigned char)(value | 0x80);
+		value >>= 7;
+	}
+	buffer[size++] = (unsigned char)value;
+
+	return size;
+}
+
+TEST neat_load_checks_genome_shape(void)
+{
+	neat_t neat;
+	struct neat_config config;
+	FILE *file;
+	unsigned char *data, genome[4096], prefix[8];
+	long size;
+	size_t offset, genome_size, nprefix;
+
+	config = neat_xor_config(20, 1111);
+	neat = neat_xor_create(config, 50);
+	ASSERT(neat);
+
+	file = tmpfile();
+	ASSERT(file);
+	ASSERT(neat_save(neat, file, false));
+	size = ftell(file);
+	rewind(file);
+	data = malloc(size);
+	ASSERT(data);
+	ASSERT_EQ(size, (long)fread(data, 1, size, file));
+	fclose(file);
+
+	/* Without compression the first genome is stored in full, the same
+	 * as neat_encode_genome writes it, after its size
+	 */
+	genome_size = neat_encode_genome(neat, 0, genome, sizeof(genome));
+	ASSERT(genome_size <= sizeof(genome));
+	nprefix = neat_write_test_varint(prefix, genome_size);
+	for(offset = nprefix; offset + genome_size <= (size_t)size; offset++){
+		if(memcmp(data + offset, genome, genome_size) == 0 &&
+		   memcmp(data + offset - nprefix, prefix, nprefix) == 0){
+			break;
+		}
+	}
+	ASSERT(offset + genome_size <= (size_t)size);
+
+	/* Replace the single byte of its inputs with 2^40, which must be
+	 * rejected without allocating the network
+	 */
+	ASSERT_EQ(2, genome[9]);
+	file = tmpfile();
+	ASSERT(file);
+	fwrite(data, 1, offset - nprefix, file);
+	nprefix = neat_write_test_varint(prefix, genome_size + 5);
+	fwrite(prefix, 1, nprefix, file);
+	fwrite(genome, 1, 9, file);
+	fwrite("\x80\x80\x80\x80\x80\x20", 1, 6, file);
+	fwrite(genome + 10, 1, genome_size - 10, file);
+	fwrite(data + offset + genome_size,
+	       1,
+	       size - offset - genome_size,
+	       file);
+	rewind(file);
+	ASSERT_EQ(NULL, neat_load(file));
+	fclose(file);
+
+	free(data);
+	neat_destroy(neat);
+	PASS();
+}
+
+TEST neat_snapshot_matches_population(void)
+{
+	neat_t neat;
+	neat_snapshot_t snapshot;
+	struct neat_config config;
+	FILE *file;
+	void *data;
+	long size;
+	size_t i, j;
+
+	config = neat_xor_config(50, 1357);
+	config.genome_minimum_ticks_alive = 5;
+
+	neat = neat_xor_create(config, 200);
+	ASSERT(neat);
+
+	file = tmpfile();
+	ASSERT(file);
+	ASSERT(neat_save_snapshot(neat, file));
+	size = ftell(file);
+	rewind(file);
+	data = malloc(size);
+	ASSERT(data);
+	ASSERT_EQ(size, (long)fread(data, 1, size, file));
+	fclose(file);
+
+	/* A truncated snapshot must be rejected */
+	ASSERT_EQ(NULL, neat_snapshot_open(data, size / 2));
+
+	snapshot = neat_snapshot_open(data, size);
+	ASSERT(snapshot);
+	ASSERT_EQ(config.population_size,
+		  neat_snapshot_get_num_genomes(snapshot));
+	for(i = 0; i < config.population_size; i++){
+		const float inputs[2] = {1.0f, 0.0f};
+		float output;
+
+		ASSERT(nn_ffnet_equal(neat_get_network(neat, i),
+				      neat_snapshot_get_network(snapshot, i)));
+		ASSERT_EQ(neat_get_fingerprint(neat, i),
+			  neat_snapshot_get_fingerprint(snapshot, i));
+		ASSERT_EQ(neat_get_species_id(neat, i),
+			  neat_snapshot_get_species_id(snapshot, i));
+
+		output = neat_run(neat, i, inputs)[0];
+		ASSERT_EQ(output, neat_run_snapshot(snapshot, i, inputs)[0]);
+	}
+
+	ASSERT_EQ(neat_get_num_species(neat),
+		  neat_snapshot_get_num_species(snapshot));
+	for(i = 0; i < neat_get_num_species(neat); i++){
+		size_t ngenomes;
+
+		ngenomes = neat_snapshot_get_num_genomes_in_species(snapshot, i);
+		ASSERT_EQ(neat_get_num_genomes_in_species(neat, i), ngenomes);
+		for(j = 0; j < ngenomes; j++){
+			size_t genome_id;
+
+			genome_id = neat_snapshot_get_genome_in_species(snapshot,
+									i,
+									j);
+			ASSERT_EQ(i, neat_get_species_id(neat, genome_id));
+		}
+	}
+
+	neat_snapshot_close(snapshot);
+	free(data);
+	neat_destroy(neat);
+	PASS();
+}
+
+TEST neat_snapshot_map_file(void)
+{
+	const char *path = "neat-snapshot-test.bin";
+	neat_t neat;
+	neat_snapshot_t snapshot;
+	struct neat_config config;
+	FILE *file;
+	void *data;
+	long size;
+	size_t i;
+
+	config = neat_xor_config(50, 2468);
+	config.genome_minimum_ticks_alive = 5;
+
+	neat = neat_xor_create(config, 200);
+	ASSERT(neat);
+
+	file = fopen(path, "wb");
+	ASSERT(file);
+	ASSERT(neat_save_snapshot(neat, file));
+	ASSERT_EQ(0, fclose(file));
+
+	snapshot = neat_snapshot_map(path);
+	ASSERT(snapshot);
+	ASSERT_EQ(config.population_size,
+		  neat_snapshot_get_num_genomes(snapshot));
+	ASSERT_EQ(neat_get_num_species(neat),
+		  neat_snapshot_get_num_species(snapshot));
+	for(i = 0; i < config.population_size; i++){
+		const float inputs[2] = {0.0f, 1.0f};
+		float output;
+
+		ASSERT(nn_ffnet_equal(neat_get_network(neat, i),
+				      neat_snapshot_get_network(snapshot, i)));
+		ASSERT_EQ(neat_get_species_id(neat, i),
+			  neat_snapshot_get_species_id(snapshot, i));
+
+		output = neat_run(neat, i, inputs)[0];
+		ASSERT_EQ(output, neat_run_snapshot(snapshot, i, inputs)[0]);
+	}
+	neat_snapshot_close(snapshot);
+
+	/* Write back only the first half, mapping it must fail */
+	file = fopen(path, "rb");
+	ASSERT(file);
+	ASSERT_EQ(0, fseek(file, 0, SEEK_END));
+	size = ftell(file);
+	rewind(file);
+	data = malloc(size);
+	ASSERT(data);
+	ASSERT_EQ(size, (long)fread(data, 1, size, file));
+	fclose(file);
+
+	file = fopen(path, "wb");
+	ASSERT(file);
+	ASSERT_EQ(size / 2, (long)fwrite(data, 1, size / 2, file));
+	ASSERT_EQ(0, fclose(file));
+	free(data);
+
+	ASSERT_EQ(NULL, neat_snapshot_map(path));
+	ASSERT_EQ(0, remove(path));
+	ASSERT_EQ(NULL, neat_snapshot_map(path));
+
+	neat_destroy(neat);
+	PASS();
+}
+
+static float neat_xor_worker_fitness(struct neat_worker *worker,
+				     size_t genome_id,
+				     void *user_data)
+{
+	float error;
+	int k;
+
+	/* Count the evaluations of every genome when it's asked for */
+	if(user_data){
+		((size_t*)user_data)[genome_id]++;
+	}
+
+	error = 0.0f;
+	for(k = 0; k < 4; k++){
+		const float *results;
+
+		results = neat_worker_run(worker, xor_inputs[k]);
+		error += fabs(results[0] - xor_outputs[k]);
+	}
+
+	return (4.0 - error) / 4.0;
+}
+
+TEST neat_evaluate_parallel_matches_serial(void)
+{
+	neat_t neat1, neat2;
+	struct neat_pop *p;
+	struct neat_config config;
+	size_t i, j, counts[100];
+
+	config = neat_xor_config(100, 31337);
+
+	neat1 = neat_create(config);
+	ASSERT(neat1);
+	neat2 = neat_create(config);
+	ASSERT(neat2);
+	p = neat1;
+
+	for(i = 0; i < 300; i++){
+		memset(counts, 0, sizeof(counts));
+		neat_evaluate_parallel(neat1,
+				       neat_xor_worker_fitness,
+				       counts,
+				       8);
+
+		/* Every genome must be evaluated once and get the fitness of
+		 * its own network, without aging it
+		 */
+		for(j = 0; j < config.population_size; j++){
+			ASSERT_EQ(1, counts[j]);
+			ASSERT_EQ(neat_xor_fitness(neat1, j),
+				  p->organisms[j].fitness);
+			ASSERT_EQ(0, p->organisms[j].time_alive);
+		}
+
+		neat_tick(neat1);
+		neat_epoch(neat1, NULL);
+
+		neat_xor_epoch(neat2, config.population_size);
+	}
+
+	ASSERT_EQ(neat_get_num_species(neat1), neat_get_num_species(neat2));
+	for(i = 0; i < config.population_size; i++){
+		ASSERT(nn_ffnet_equal(neat_get_network(neat1, i),
+				      neat_get_network(neat2, i)));
+	}
+
+	neat_destroy(neat1);
+	neat_destroy(neat2);
+	PASS();
+}
+
+static size_t neat_xor_generation(neat_t neat,
+				  size_t population_size,
+				  size_t *replaced)
+{
+	size_t i;
+
+	for(i = 0; i < population_size; i++){
+		neat_set_fitness(neat, i, neat_xor_fitness(neat, i));
+	}
+
+	neat_tick(neat);
+	return neat_epoch_generation(neat, replaced);
+}
+
+TEST neat_generation_threads(void)
+{
+	neat_t neat1, neat2;
+	struct neat_config config;
+	size_t i, j, count1, count2, replaced1[100], replaced2[100];
+
+	config = neat_xor_config(100, 2024);
+	config.generation_replacement_fraction = 0.3;
+
+	neat1 = neat_create(config);
+	ASSERT(neat1);
+	config.threads = 4;
+	neat2 = neat_create(config);
+	ASSERT(neat2);
+
+	/* The amount of threads must not change the offspring */
+	for(i = 0; i < 100; i++){
+		count1 = neat_xor_generation(neat1,
+					     config.population_size,
+					     replaced1);
+		count2 = neat_xor_generation(neat2,
+					     config.population_size,
+					     replaced2);
+		ASSERT_EQ(count1, count2);
+		/* The first generation is still too young to be replaced */
+		ASSERT_EQ(i > 0 ? 30 : 0, count1);
+		for(j = 0; j < count1; j++){
+			ASSERT(replaced1[j] < config.population_size);
+			ASSERT_EQ(replaced1[j], replaced2[j]);
+		}
+	}
+	ASSERT(count1 > 0);
+
+	ASSERT_EQ(neat_get_num_species(neat1), neat_get_num_species(neat2));
+	for(i = 0; i < config.population_size; i++){
+		ASSERT(nn_ffnet_equal(neat_get_network(neat1, i),
+				      neat_get_network(neat2, i)));
+	}
+
+	neat_destroy(neat1);
+	neat_destroy(neat2);
+	PASS();
+}
+
+TEST neat_generation_replaces_weakest(void)
+{
+	neat_t neat;
+	struct neat_pop *p;
+	struct neat_config config;
+	size_t i, j, count, neligible, replaced[100];
+	bool eligible[100], is_replaced[100];
+	float fitness[100], weakest_kept, strongest_replaced;
+
+	/* Keep a single species so the adjusted fitness orders the genomes
+	 * the same way as the fitness
+	 */
+	config = neat_xor_config(100, 2025);
+	config.generation_replacement_fraction = 0.3;
+	config.genome_compatibility_treshold = 1e6f;
+	config.species_stagnations_allowed = 1000;
+
+	neat = neat_create(config);
+	ASSERT(neat);
+	p = neat;
+
+	for(i = 0; i < 100; i++){
+		for(j = 0; j < config.population_size; j++){
+			fitness[j] = neat_xor_fitness(neat, j);
+			neat_set_fitness(neat, j, fitness[j]);
+		}
+		neat_tick(neat);
+		ASSERT_EQ(1, neat_get_num_species(neat));
+
+		neligible = 0;
+		for(j = 0; j < config.population_size; j++){
+			eligible[j] = neat_organism_age(p, j) >
+				      config.genome_minimum_ticks_alive;
+			neligible += eligible[j];
+			is_replaced[j] = false;
+		}
+
+		/* The whole fraction is replaced if enough genomes are old
+		 * enough
+		 */
+		count = neat_epoch_generation(neat, replaced);
+		ASSERT_EQ(neligible < 30 ? neligible : 30, count);
+
+		strongest_replaced = -FLT_MAX;
+		for(j = 0; j < count; j++){
+			ASSERT(eligible[replaced[j]]);
+			ASSERT_FALSE(is_replaced[replaced[j]]);
+			is_replaced[replaced[j]] = true;
+			if(fitness[replaced[j]] > strongest_replaced){
+				strongest_replaced = fitness[replaced[j]];
+			}
+		}
+
+		/* None of the kept genomes that could be replaced is weaker */
+		weakest_kept = FLT_MAX;
+		for(j = 0; j < config.population_size; j++){
+			if(eligible[j] && !is_replaced[j] &&
+			   fitness[j] < weakest_kept){
+				weakest_kept = fitness[j];
+			}
+		}
+		ASSERT(strongest_replaced <= weakest_kept);
+	}
+
+	neat_destroy(neat);
+	PASS();
+}
+
+TEST neat_respeciation_threads(void)
+{
+	neat_t neat1, neat2;
+	struct neat_pop *p;
+	struct neat_config config;
+	struct neat_species *old_species[100];
+	size_t i, j, k, nspecies, total;
+
+	config = neat_xor_config(100, 4096);
+	config.species_ticks_before_reassignment = 1;
+
+	neat1 = neat_create(config);
+	ASSERT(neat1);
+	config.threads = 4;
+	neat2 = neat_create(config);
+	ASSERT(neat2);
+	p = neat2;
+
+	/* Respeciating on multiple threads must assign every genome to the
+	 * same species
+	 */
+	for(i = 0; i < 300; i++){
+		neat_xor_epoch(neat1, config.population_size);
+		neat_xor_epoch(neat2, config.population_size);
+
+		ASSERT_EQ(neat_get_num_species(neat1),
+			  neat_get_num_species(neat2));
+		for(j = 0; j < config.population_size; j++){
+			ASSERT_EQ(neat_get_species_id(neat1, j),
+				  neat_get_species_id(neat2, j));
+		}
+
+		/* Every genome must end up compatible with the representant
+		 * of its species, the old species are compared with the
+		 * amount of species at the start and the new ones with at
+		 * most the amount at the end, the active species keep their
+		 * representant so they can't be reused for new ones
+		 */
+		ASSERT(p->nspecies <= config.population_size);
+		nspecies = 0;
+		for(j = 0; j < p->nspecies; j++){
+			if(p->species[j]->active){
+				old_species[nspecies++] = p->species[j];
+			}
+		}
+		total = p->nspecies;
+		neat_respeciate_genomes(p);
+
+		for(j = 0; j < config.population_size; j++){
+			struct neat_species *species;
+			size_t rep_id, total_species;
+
+			species = p->species[p->organisms[j].species];
+			ASSERT(species->active);
+			rep_id = neat_species_get_representant(species);
+			if(rep_id == j){
+				continue;
+			}
+
+			total_species = p->nspecies;
+			for(k = 0; k < nspecies; k++){
+				if(old_species[k] == species){
+					total_species = total;
+				}
+			}
+			ASSERT(neat_genome_is_compatible(
+				p->genomes[j],
+				p->genomes[rep_id],
+				config.genome_compatibility_treshold,
+				total_species));
+		}
+		neat_respeciate_genomes(neat1);
+	}
+
+	neat_destroy(neat1);
+	neat_destroy(neat2);
+	PASS();
+}
+
+TEST neat_fingerprint_memo(void)
+{
+	neat_t neat;
+	struct neat_config config;
+	size_t i, j, found;
+
+	config = neat_xor_config(50, 7);
+	config.fitness_memo_size = 100;
+
+	neat = neat_xor_create(config, 300);
+	ASSERT(neat);
+
+	/* The fingerprints are the same exactly when the networks are */
+	for(i = 0; i < config.population_size; i++){
+		for(j = i + 1; j < config.population_size; j++){
+			bool equal;
+
+			equal = nn_ffnet_equal(neat_get_network(neat, i),
+					       neat_get_network(neat, j));
+			ASSERT_EQ(equal,
+				  neat_get_fingerprint(neat, i) ==
+				  neat_get_fingerprint(neat, j));
+		}
+	}
+
+	/* A remembered fitness must be the one of the same network */
+	found = 0;
+	for(i = 0; i < config.population_size; i++){
+		float fitness;
+
+		if(neat_get_memoized_fitness(neat, i, &fitness)){
+			ASSERT_EQ_FMT(neat_xor_fitness(neat, i), fitness, "%g");
+			found++;
+		}
+	}
+	ASSERT(found > 0);
+
+	neat_destroy(neat);
+	PASS();
+}
+
+TEST neat_encode_decode(void)
 {
+	neat_t neat, other;
 	struct neat_config config;
+	unsigned char buffer[4096];
+	const struct nn_ffnet *expected;
+	size_t size, delta_size;
+
+	config = neat_xor_config(20, 99);
+	config.network_hidden_nodes = 3;
+
+	neat = neat_xor_create(config, 200);
+	ASSERT(neat);
+
+	/* Full encoding */
+	size = neat_encode_genome(neat, 0, buffer, sizeof(buffer));
+	ASSERT(size <= sizeof(buffer));
+	ASSERT(neat_decode_genome(neat, 1, buffer, size));
+	ASSERT(nn_ffnet_equal(neat_get_network(neat, 0),
+			      neat_get_network(neat, 1)));
+	ASSERT_EQ(neat_get_fingerprint(neat, 0), neat_get_fingerprint(neat, 1));
+
+	/* A delta against itself is only the header */
+	delta_size = neat_encode_genome_delta(neat, 2, 2, buffer,
+					      sizeof(buffer));
+	ASSERT(delta_size < size);
+
+	/* Delta against another genome, the parent is found by fingerprint */
+	size = neat_encode_genome_delta(neat, 2, 3, buffer, sizeof(buffer));
+	ASSERT(size <= sizeof(buffer));
+	ASSERT(neat_decode_genome(neat, 4, buffer, size));
+	expected = neat_get_network(neat, 2);
+	ASSERT(nn_ffnet_equal(expected, neat_get_network(neat, 4)));
+	ASSERT_EQ(neat_get_fingerprint(neat, 2), neat_get_fingerprint(neat, 4));
+
+	/* Truncated and corrupted data is rejected */
+	size = neat_encode_genome(neat, 5, buffer, sizeof(buffer));
+	ASSERT_FALSE(neat_decode_genome(neat, 6, buffer, size - 1));
+	/* Flip a bit of the bias that comes after the kind, the fingerprint
+	 * and the shape
+	 */
+	buffer[15] ^= 0x10;
+	ASSERT_FALSE(neat_decode_genome(neat, 6, buffer, size));
+
+	/* A genome with another amount of inputs is rejected */
+	config.network_inputs = 3;
+	other = neat_create(config);
+	ASSERT(other);
+	size = neat_encode_genome(other, 0, buffer, sizeof(buffer));
+	ASSERT(size <= sizeof(buffer));
+	ASSERT_FALSE(neat_decode_genome(neat, 6, buffer, size));
+	neat_destroy(other);
+
+	/* So is a huge amount of inputs, before the network is allocated, the
+	 * single byte of the inputs is replaced by 2^40
+	 */
+	size = neat_encode_genome(neat, 5, buffer, sizeof(buffer));
+	ASSERT(size + 5 <= sizeof(buffer));
+	ASSERT_EQ(2, buffer[9]);
+	memmove(buffer + 15, buffer + 10, size - 10);
+	memcpy(buffer + 9, "\x80\x80\x80\x80\x80\x20", 6);
+	ASSERT_FALSE(neat_decode_genome(neat, 6, buffer, size + 5));
+
+	/* The decoded genomes are speciated again */
+	ASSERT(neat_get_species_id(neat, 1) < neat_get_num_species(neat));
+	ASSERT(neat_get_species_id(neat, 4) < neat_get_num_species(neat));
+
+	neat_destroy(neat);
+	PASS();
+}
+
+TEST neat_species_handles(void)
+{
 	neat_t neat;
+	struct neat_config config;
+	uint64_t handles[50];
+	size_t i, j, valid, invalid;
 
-	config = neat_get_default_config();
-	config.network_inputs = 1;
-	config.network_outputs = 1;
-	config.network_hidden_nodes = 1;
-	config.population_size = 1;
-	config.minimum_time_before_replacement = 1;
+	config = neat_xor_config(50, 77);
+	/* Species die quickly so some of the handles become invalid */
+	config.species_stagnation_treshold = 50;
+	config.species_stagnations_allowed = 0;
+
+	neat = neat_xor_create(config, 100);
+	ASSERT(neat);
+
+	for(i = 0; i < config.population_size; i++){
+		handles[i] = neat_get_species_handle(neat, i);
+		ASSERT(handles[i] != NEAT_SPECIES_HANDLE_NONE);
+		ASSERT_EQ(neat_get_species_id_of_handle(neat, handles[i]),
+			  neat_get_species_id(neat, i));
+	}
+
+	for(i = 0; i < 200; i++){
+		neat_xor_epoch(neat, config.population_size);
+	}
+
+	/* A stored handle is valid exactly while a genome is still in its
+	 * species, and then it points to that species
+	 */
+	valid = invalid = 0;
+	for(i = 0; i < config.population_size; i++){
+		size_t species_id;
+		bool alive;
+
+		alive = false;
+		for(j = 0; j < config.population_size; j++){
+			alive |= neat_get_species_handle(neat, j) == handles[i];
+		}
+
+		species_id = neat_get_species_id_of_handle(neat, handles[i]);
+		if(!alive){
+			ASSERT_EQ(SIZE_MAX, species_id);
+			invalid++;
+			continue;
+		}
+		ASSERT(species_id < neat_get_num_species(neat));
+
+		for(j = 0; j < config.population_size; j++){
+			ASSERT_EQ(neat_get_species_id(neat, j) == species_id,
+				  neat_get_species_handle(neat, j) ==
+				  handles[i]);
+		}
+		valid++;
+	}
+	ASSERT(valid > 0);
+	ASSERT(invalid > 0);
+
+	ASSERT_EQ(neat_get_species_id_of_handle(neat,
+						NEAT_SPECIES_HANDLE_NONE),
+		  SIZE_MAX);
+
+	neat_destroy(neat);
+	PASS();
+}
+
+/* The population starts with all the genomes in one species, the fitnesses are
+ * unique so the order is known
+ */
+TEST neat_species_second_genitor(void)
+{
+	const float fitnesses[5] = {0.1f, 0.7f, 0.4f, 0.9f, 0.6f};
+	struct neat_config config;
+	struct neat_species *species;
+	struct neat_pop *p;
+	neat_t neat;
+	size_t i;
+
+	/* A single genome is its own second genitor */
+	config = neat_xor_config(1, 0);
+	neat = neat_create(config);
+	ASSERT(neat);
+	p = neat;
+	species = p->species[0];
+	ASSERT_EQ(1, species->ngenomes);
+	neat_set_fitness(neat, 0, 0.5f);
+	ASSERT_EQ(0, neat_species_select_genitor(p, species));
+	ASSERT_EQ(0, neat_species_select_second_genitor(p, species));
+	neat_destroy(neat);
 
+	/* With two genomes it's the other one, in both orders */
+	config.population_size = 2;
 	neat = neat_create(config);
 	ASSERT(neat);
+	p = neat;
+	species = p->species[0];
+	ASSERT_EQ(2, species->ngenomes);
+	neat_set_fitness(neat, 0, 0.3f);
+	neat_set_fitness(neat, 1, 0.8f);
+	ASSERT_EQ(1, neat_species_select_genitor(p, species));
+	ASSERT_EQ(0, neat_species_select_second_genitor(p, species));
+	neat_set_fitness(neat, 0, 0.9f);
+	ASSERT_EQ(0, neat_species_select_genitor(p, species));
+	ASSERT_EQ(1, neat_species_select_second_genitor(p, species));
+	neat_destroy(neat);
 
+	config.population_size = 5;
+	neat = neat_create(config);
+	ASSERT(neat);
+	p = neat;
+	species = p->species[0];
+	ASSERT_EQ(5, species->ngenomes);
+	for(i = 0; i < 5; i++){
+		neat_set_fitness(neat, i, fitnesses[i]);
+	}
+	ASSERT_EQ(3, neat_species_select_genitor(p, species));
+	ASSERT_EQ(1, neat_species_select_second_genitor(p, species));
+
+	/* The order follows changes of the fitness */
+	neat_set_fitness(neat, 4, 0.8f);
+	ASSERT_EQ(4, neat_species_select_second_genitor(p, species));
+	neat_set_fitness(neat, 3, 0.2f);
+	ASSERT_EQ(4, neat_species_select_genitor(p, species));
+	ASSERT_EQ(1, neat_species_select_second_genitor(p, species));
 	neat_destroy(neat);
+
 	PASS();
 }
 
-TEST neat_xor(void)
+/* The worst genome from the heaps must be the one a scan over the whole
+ * population finds, while the fitnesses, the ages and the species change
+ */
+TEST neat_worst_genome_matches_scan(void)
 {
+	struct neat_config config;
+	struct neat_pop *p;
+	struct nn_rng rng;
 	neat_t neat;
+	size_t i, j, worst, scanned, nchecked;
+	float worst_fitness;
+	bool found;
+
+	config = neat_xor_config(60, 404);
+	config.genome_minimum_ticks_alive = 3;
+	config.species_ticks_before_reassignment = 5;
+
+	neat = neat_create(config);
+	ASSERT(neat);
+	p = neat;
+	nn_rng_seed(&rng, 405);
+
+	nchecked = 0;
+	for(i = 0; i < 400; i++){
+		for(j = 0; j < 10; j++){
+			neat_set_fitness(neat,
+					 nn_rng_index(&rng, config.population_size),
+					 nn_rng_float(&rng));
+		}
+		neat_increase_time_alive(neat,
+					 nn_rng_index(&rng,
+						      config.population_size));
+
+		found = neat_find_worst_genome(p, &worst);
+		if(p->dead_first){
+			/* The genomes of dead species go first */
+			ASSERT(found);
+			ASSERT_FALSE(p->species[p->organisms[worst].species]->active);
+		}else{
+			scanned = SIZE_MAX;
+			worst_fitness = FLT_MAX;
+			for(j = 0; j < config.population_size; j++){
+				struct neat_species *species;
+				float fitness;
+
+				if(neat_organism_age(p, j) <=
+				   config.genome_minimum_ticks_alive){
+					continue;
+				}
+
+				species = p->species[p->organisms[j].species];
+				fitness = neat_species_get_adjusted_fitness(
+					species,
+					p->organisms[j].fitness);
+				if(fitness < worst_fitness){
+					scanned = j;
+					worst_fitness = fitness;
+				}
+			}
+
+			/* Genomes with the same adjusted fitness are equally
+			 * bad, so only the fitness has to match
+			 */
+			ASSERT_EQ(scanned != SIZE_MAX, found);
+			if(found){
+				ASSERT(neat_organism_age(p, worst) >
+				       config.genome_minimum_ticks_alive);
+				ASSERT_EQ(worst_fitness,
+					  neat_species_get_adjusted_fitness(
+						p->species[p->organisms[worst].species],
+						p->organisms[worst].fitness));
+				nchecked++;
+			}
+		}
+
+		neat_tick(neat);
+		neat_epoch(neat, NULL);
+	}
+	ASSERT(nchecked > 100);
+
+	neat_destroy(neat);
+	PASS();
+}
+
+/* Amount of blocks the pool keeps for recycling */
+static size_t neat_pool_count(const struct neat_pool *pool)
+{
+	size_t i, count;
+	void *block;
+
+	count = 0;
+	for(i = 0; i < NEAT_POOL_CLASSES; i++){
+		for(block = pool->free[i]; block; block = *(void**)block){
+			count++;
+		}
+	}
+
+	return count;
+}
+
+TEST neat_genome_reproduce_in_place(void)
+{
 	struct neat_config config;
-	size_t i;
-	float max_fitness;
+	struct neat_pool pool;
+	struct nn_rng rng;
+	struct neat_genome *parent1, *parent2, *dest, *expected, *child;
+	size_t nfree;
+	int i, innovation;
 
 	config = neat_get_default_config();
 	config.network_inputs = 2;
 	config.network_outputs = 1;
-	config.network_hidden_nodes = 2;
+	config.network_hidden_nodes = 4;
 
-	config.population_size = 300;
-	/* Genomes don't have to survive for very long because their survival
-	 * state is determined in 1 tick
+	neat_pool_init(&pool);
+	nn_rng_seed(&rng, 31337);
+
+	/* The first mutation always adds a hidden layer, the parents only
+	 * differ in their weights and links after that so they keep the same
+	 * shape
 	 */
-	config.genome_minimum_ticks_alive = 1;
-	config.minimum_time_before_replacement = 1;
+	innovation = 1;
+	parent1 = neat_genome_create(&pool, &rng, config, innovation);
+	parent1 = neat_genome_mutate(&pool, &rng, parent1, config, ++innovation);
+	ASSERT_EQ(1, parent1->net->nhidden_layers);
+
+	config.genome_add_neuron_mutation_probability = 0.0f;
+	parent2 = neat_genome_copy(&pool, parent1);
+	dest = neat_genome_copy(&pool, parent1);
+	for(i = 0; i < 10; i++){
+		parent1 = neat_genome_mutate(&pool,
+					     &rng,
+					     parent1,
+					     config,
+					     ++innovation);
+		parent2 = neat_genome_mutate(&pool,
+					     &rng,
+					     parent2,
+					     config,
+					     ++innovation);
+		dest = neat_genome_mutate(&pool, &rng, dest, config, ++innovation);
+	}
+	ASSERT_EQ(1, parent2->net->nhidden_layers);
+	ASSERT_EQ(1, dest->net->nhidden_layers);
 
-	/* We only rarely want to add another nouron because a XOR network
-	 * should work just fine with 1 hidden layer
+	/* The child in a new block is what the reused one must contain */
+	expected = neat_genome_reproduce(&pool, NULL, parent1, parent2);
+	ASSERT(!nn_ffnet_equal(expected->net, dest->net));
+
+	/* Keep a free block of the same size class in the pool, allocating a
+	 * new genome would take it and releasing the destination would add one
 	 */
-	config.genome_add_neuron_mutation_probability = 0.01;
+	neat_genome_destroy(&pool, neat_genome_copy(&pool, parent1));
+	nfree = neat_pool_count(&pool);
+	ASSERT(nfree > 0);
+
+	child = neat_genome_reproduce(&pool, dest, parent1, parent2);
+	ASSERT_EQ(dest, child);
+	ASSERT_EQ(nfree, neat_pool_count(&pool));
+
+	ASSERT(nn_ffnet_equal(expected->net, child->net));
+	ASSERT_EQ(expected->ninnov_weights, child->ninnov_weights);
+	ASSERT_MEM_EQ(expected->innov_weight,
+		      child->innov_weight,
+		      sizeof(int) * child->ninnov_weights);
+	ASSERT_EQ(expected->ninnov_activs, child->ninnov_activs);
+	ASSERT_MEM_EQ(expected->innov_activ,
+		      child->innov_activ,
+		      sizeof(int) * child->ninnov_activs);
+	ASSERT_EQ(expected->used_weights, child->used_weights);
+	ASSERT_EQ(expected->used_activs, child->used_activs);
+	ASSERT_EQ(expected->fingerprint, child->fingerprint);
+
+	neat_genome_destroy(&pool, child);
+
+	/* A shared destination is left alone for the other organisms */
+	dest = neat_genome_share(parent2);
+	child = neat_genome_reproduce(&pool, dest, expected, parent1);
+	ASSERT(child != parent2);
+	ASSERT_EQ(1, parent2->refs);
+	ASSERT(!nn_ffnet_equal(child->net, parent2->net));
+
+	neat_genome_destroy(&pool, child);
+	neat_genome_destroy(&pool, expected);
+	neat_genome_destroy(&pool, parent2);
+	neat_genome_destroy(&pool, parent1);
+	neat_pool_clear(&pool);
+	PASS();
+}
+
+TEST neat_species_membership(void)
+{
+	neat_t neat;
+	struct neat_config config;
+	size_t i, j, total;
+
+	config = neat_xor_config(50, 3);
+	config.species_ticks_before_reassignment = 1;
 
 	neat = neat_create(config);
 	ASSERT(neat);
 
-	max_fitness = 0.0f;
+	for(i = 0; i < 300; i++){
+		neat_xor_epoch(neat, config.population_size);
 
-	/* Epochs */
-	for(i = 0; i < 10000; i++){
-		size_t j;
+		/* The species of the genomes must add up to the species
+		 * sizes
+		 */
+		total = 0;
+		for(j = 0; j < neat_get_num_species(neat); j++){
+			size_t k, count;
 
-		/* Organisms */
-		for(j = 0; j < config.population_size; j++){
-			float fitness, error;
-			int k;
+			count = 0;
+			for(k = 0; k < config.population_size; k++){
+				count += neat_get_species_id(neat, k) == j;
+			}
+			ASSERT_EQ(neat_get_num_genomes_in_species(neat, j),
+				  count);
+			total += count;
+		}
+		ASSERT_EQ(config.population_size, total);
+	}
 
-			/* XOR sets */
-			error = 0.0f;
-			for(k = 0; k < 4; k++){
-				const float *results;
+	neat_destroy(neat);
+	PASS();
+}
 
-				results = neat_run(neat, j, xor_inputs[k]);
-				ASSERT(results);
+TEST neat_species_fitness_sum(void)
+{
+	neat_t neat;
+	struct neat_pop *p;
+	struct neat_config config;
+	size_t i, j, k;
+	bool repopulated;
 
-				error += fabs(results[0] - xor_outputs[k]);
-			}
+	/* Stagnate quickly so species are repopulated along the way */
+	config = neat_xor_config(50, 1357);
+	config.species_stagnation_treshold = 3;
+	config.species_stagnations_allowed = 1000;
 
-			fitness = (4.0 - error) / 4.0;
+	neat = neat_create(config);
+	ASSERT(neat);
+	p = neat;
 
-			if(fitness > 0.9){
-				char message[512];
+	repopulated = false;
+	for(i = 0; i < 500; i++){
+		neat_xor_epoch(neat, config.population_size);
 
-				neat_destroy(neat);
+		/* The kept sum must be the sum over the members */
+		for(j = 0; j < p->nspecies; j++){
+			const struct neat_species *species;
+			double sum;
 
-				sprintf(message,
-					"Found solution after %d iterations",
-					(int)i);
-				
-				PASSm(message);
+			species = p->species[j];
+			sum = 0.0;
+			for(k = 0; k < species->ngenomes; k++){
+				sum += p->organisms[species->genomes[k]].fitness;
 			}
+			ASSERT_IN_RANGE(sum, species->fitness_sum, 1e-6);
 
-			if(fitness > max_fitness){
-				max_fitness = fitness;
-			}
+			repopulated |= species->times_stagnated > 0;
+		}
+	}
+	ASSERT(repopulated);
 
-			neat_set_fitness(neat, j, fitness);
+	neat_destroy(neat);
+	PASS();
+}
 
-			neat_increase_time_alive(neat, j);
+TEST neat_species_selection_frequencies(void)
+{
+	neat_t neat;
+	struct neat_pop *p;
+	struct neat_config config;
+	size_t i, nspecies, *counts;
+	double total;
+	const size_t nsamples = 200000;
+
+	config = neat_xor_config(100, 2021);
+
+	neat = neat_create(config);
+	ASSERT(neat);
+	p = neat;
+
+	for(i = 0; i < 1000 && p->nspecies < 5; i++){
+		neat_xor_epoch(neat, config.population_size);
+	}
+	nspecies = p->nspecies;
+	ASSERT(nspecies >= 5);
+
+	counts = calloc(nspecies, sizeof(size_t));
+	ASSERT(counts);
+
+	/* Fix the averages, every third species has none */
+	total = 0.0;
+	for(i = 0; i < nspecies; i++){
+		double weight;
+
+		weight = i % 3 == 1 ? 0.0 : (double)(i + 1);
+		neat_fenwick_set(&p->selection, i, weight);
+		total += weight;
+	}
+
+	for(i = 0; i < nsamples; i++){
+		counts[neat_select_species(p)]++;
+	}
+
+	/* The species must be picked in proportion to their averages */
+	for(i = 0; i < nspecies; i++){
+		if(i % 3 == 1){
+			ASSERT_EQ(0, counts[i]);
+		}else{
+			ASSERT_IN_RANGE((double)(i + 1) / total,
+					(double)counts[i] / nsamples,
+					0.01);
 		}
+	}
 
-		neat_epoch(neat, NULL);
+	/* Only the species with a weight can be picked */
+	for(i = 0; i < nspecies; i++){
+		neat_fenwick_set(&p->selection, i, i == 2 ? 1e-6 : 0.0);
+	}
+	for(i = 0; i < nsamples; i++){
+		ASSERT_EQ(2, neat_select_species(p));
 	}
 
+	free(counts);
 	neat_destroy(neat);
-	printf("Iterations: %d, fitness: %g\n", (int)i, max_fitness);
-	PASSm("A mutation that solved the xor problem did not occur");
+	PASS();
+}
+
+TEST nn_rng_streams(void)
+{
+	struct nn_rng rng1, rng2, split, derived;
+	size_t i;
+
+	nn_rng_seed(&rng1, 42);
+	nn_rng_seed(&rng2, 42);
+
+	/* The same seed must give the same numbers in the right ranges */
+	for(i = 0; i < 1000; i++){
+		float f;
+		size_t index;
+
+		ASSERT_EQ(nn_rng_next(&rng1), nn_rng_next(&rng2));
+
+		f = nn_rng_uniform(&rng1, -2.0f, 2.0f);
+		ASSERT(f >= -2.0f && f < 2.0f);
+		nn_rng_uniform(&rng2, -2.0f, 2.0f);
+
+		index = nn_rng_index(&rng1, 7);
+		ASSERT(index < 7);
+		nn_rng_index(&rng2, 7);
+	}
+
+	/* A split stream continues where the original was */
+	split = nn_rng_split(&rng1);
+	ASSERT_EQ(nn_rng_next(&rng2), nn_rng_next(&split));
+	ASSERT(nn_rng_next(&rng1) != nn_rng_next(&split));
+
+	/* Deriving the same id twice gives the same stream */
+	derived = nn_rng_derive(&rng2, 7);
+	split = nn_rng_derive(&rng2, 7);
+	ASSERT_EQ(nn_rng_next(&derived), nn_rng_next(&split));
+	split = nn_rng_derive(&rng2, 8);
+	ASSERT(nn_rng_next(&derived) != nn_rng_next(&split));
+
+	PASS();
+}
+
+TEST nn_rng_fill(void)
+{
+	struct nn_rng rng;
+	float *values, sum, square_sum, mean, deviation;
+	size_t i, count;
+
+	count = 10001;
+	values = malloc(sizeof(float) * count);
+	ASSERT(values);
+
+	nn_rng_seed(&rng, 42);
+
+	nn_rng_fill_uniform(&rng, values, count, -0.5f, 0.5f);
+	sum = 0.0f;
+	for(i = 0; i < count; i++){
+		ASSERT(values[i] >= -0.5f && values[i] < 0.5f);
+		sum += values[i];
+	}
+	ASSERT_IN_RANGE(0.0f, sum / count, 0.05f);
+
+	nn_rng_fill_gaussian(&rng, values, count, 1.0f, 2.0f);
+	sum = square_sum = 0.0f;
+	for(i = 0; i < count; i++){
+		sum += values[i];
+		square_sum += values[i] * values[i];
+	}
+	mean = sum / count;
+	deviation = sqrt(square_sum / count - mean * mean);
+	ASSERT_IN_RANGE(1.0f, mean, 0.1f);
+	ASSERT_IN_RANGE(2.0f, deviation, 0.1f);
+
+	free(values);
+	PASS();
 }
 
 TEST nn_create_and_destroy(void)
@@ -131,11 +1794,13 @@ TEST nn_create_and_destroy(void)
 TEST nn_randomize(void)
 {
 	struct nn_ffnet *net;
+	struct nn_rng rng;
 
 	net = nn_ffnet_create(2, 1, 2, 1);
 	ASSERT(net);
 
-	nn_ffnet_randomize(net);
+	nn_rng_seed(&rng, 1);
+	nn_ffnet_randomize(net, &rng);
 
 	ASSERT(net->weight[0] != 0.0f);
 
@@ -172,18 +1837,51 @@ TEST nn_copy_weights(void)
 	PASS();
 }
 
+TEST nn_init_and_copy_into(void)
+{
+	struct nn_ffnet *net, *copy;
+	void *memory, *copy_memory;
+	size_t i, bytes;
+
+	bytes = nn_ffnet_get_size(3, 2, 1, 2);
+	ASSERT(bytes > sizeof(struct nn_ffnet));
+
+	memory = malloc(bytes);
+	ASSERT(memory);
+	copy_memory = malloc(bytes);
+	ASSERT(copy_memory);
+
+	net = nn_ffnet_init(memory, 3, 2, 1, 2);
+	ASSERT_EQ(nn_ffnet_get_weight_count(3, 2, 1, 2), net->nweights);
+	ASSERT_EQ(nn_ffnet_get_activation_count(2, 1, 2), net->nactivations);
+
+	nn_ffnet_set_weights(net, 1.0f);
+
+	copy = nn_ffnet_copy_into(copy_memory, net);
+	ASSERT(copy->weight != net->weight);
+	for(i = 0; i < net->nweights; i++){
+		ASSERT_EQ_FMT(net->weight[i], copy->weight[i], "%g");
+	}
+
+	free(copy_memory);
+	free(memory);
+	PASS();
+}
+
 TEST nn_copy_neurons(void)
 {
 	const float input[] = {1, 2, 3, 4, 5, 6, 7, 8, 9, 10};
 
 	struct nn_ffnet *net, *copy;
+	struct nn_rng rng;
 	float *results, *results_copy;
 	size_t i;
 
 	net = nn_ffnet_create(10, 3, 10, 2);
 	ASSERT(net);
 
-	nn_ffnet_randomize(net);
+	nn_rng_seed(&rng, 1);
+	nn_ffnet_randomize(net, &rng);
 
 	results = nn_ffnet_run(net, input);
 
@@ -349,13 +2047,15 @@ TEST nn_add_layer_single(void)
 TEST nn_add_layer_double(void)
 {
 	struct nn_ffnet *net, *copy;
+	struct nn_rng rng;
 	size_t i;
 	int j;
 
 	net = nn_ffnet_create(2, 2, 2, 2);
 	ASSERT(net);
 
-	nn_ffnet_randomize(net);
+	nn_rng_seed(&rng, 1);
+	nn_ffnet_randomize(net, &rng);
 
 	copy = nn_ffnet_copy(net);
 
@@ -525,6 +2225,90 @@ TEST nn_run_xor(void)
 	PASS();
 }
 
+/* Compare the kernels in the library, which use SSE2 when it's available,
+ * with the scalar fallback, the counts must be odd sizes as well so the tails
+ * that don't fill a vector are covered
+ */
+TEST nn_kernels_match_scalar(void *size_data)
+{
+	float weight1[67], weight2[67], child1[67], child2[67];
+	float sum1, sum2;
+	int innov1[67], innov2[67], child_innov1[67], child_innov2[67];
+	struct nn_rng rng;
+	size_t i, count;
+
+	count = *(size_t*)size_data;
+	ASSERT(count <= 67);
+
+	nn_rng_seed(&rng, 1000 + count);
+	for(i = 0; i < count; i++){
+		/* Unset weights, weights that cancel out and clashing
+		 * innovations all have to be there
+		 */
+		weight1[i] = nn_rng_index(&rng, 4) == 0 ? 0.0f :
+			nn_rng_uniform(&rng, -1.0f, 1.0f);
+		weight2[i] = nn_rng_index(&rng, 4) == 0 ? -weight1[i] :
+			nn_rng_uniform(&rng, -1.0f, 1.0f);
+		innov1[i] = (int)nn_rng_index(&rng, 4);
+		innov2[i] = nn_rng_index(&rng, 2) == 0 ? innov1[i] :
+			(int)nn_rng_index(&rng, 4);
+	}
+
+	memcpy(child_innov1, innov1, sizeof(int) * count);
+	memcpy(child_innov2, innov1, sizeof(int) * count);
+	ASSERT_EQ(neat_kernel_scalar_mask_innovations(child_innov1,
+						      weight1,
+						      count),
+		  neat_kernel_mask_innovations(child_innov2, weight1, count));
+	ASSERT_MEM_EQ(child_innov1, child_innov2, sizeof(int) * count);
+
+	ASSERT_EQ(neat_kernel_scalar_set_innovations(child_innov1,
+						     weight2,
+						     count,
+						     7),
+		  neat_kernel_set_innovations(child_innov2, weight2, count, 7));
+	ASSERT_MEM_EQ(child_innov1, child_innov2, sizeof(int) * count);
+
+	memcpy(child1, weight1, sizeof(float) * count);
+	memcpy(child2, weight1, sizeof(float) * count);
+	memcpy(child_innov1, innov1, sizeof(int) * count);
+	memcpy(child_innov2, innov1, sizeof(int) * count);
+	ASSERT_EQ(neat_kernel_scalar_blend_matching(child1,
+						    child_innov1,
+						    weight1,
+						    weight2,
+						    innov1,
+						    innov2,
+						    count),
+		  neat_kernel_blend_matching(child2,
+					     child_innov2,
+					     weight1,
+					     weight2,
+					     innov1,
+					     innov2,
+					     count));
+	ASSERT_MEM_EQ(child_innov1, child_innov2, sizeof(int) * count);
+	for(i = 0; i < count; i++){
+		ASSERT_IN_RANGE(child1[i], child2[i], FLT_EPSILON);
+	}
+
+	ASSERT_EQ(neat_kernel_scalar_matching_difference(weight1,
+							 weight2,
+							 innov1,
+							 innov2,
+							 count,
+							 &sum1),
+		  neat_kernel_matching_difference(weight1,
+						  weight2,
+						  innov1,
+						  innov2,
+						  count,
+						  &sum2));
+	ASSERT_IN_RANGE(sum1, sum2, FLT_EPSILON * count);
+
+	PASS();
+}
+
 TEST nn_time_big(void)
 {
 	const float inputs[1024] = { 1.0 };
@@ -554,7 +2338,10 @@ SUITE(nn)
 
 	RUN_TEST(nn_create_and_destroy);
 	RUN_TEST(nn_randomize);
+	RUN_TEST(nn_rng_streams);
+	RUN_TEST(nn_rng_fill);
 	RUN_TEST(nn_copy_weights);
+	RUN_TEST(nn_init_and_copy_into);
 	RUN_TEST(nn_copy_neurons);
 	RUN_TEST(nn_neuron_is_connected);
 	RUN_TEST(nn_add_layer_zero);
@@ -568,6 +2355,12 @@ SUITE(nn)
 	RUN_TEST(nn_run);
 	RUN_TEST(nn_run_relu);
 	RUN_TEST(nn_run_xor);
+
+	for(i = 0; i <= 17; i++){
+		RUN_TEST1(nn_kernels_match_scalar, (void*)&i);
+	}
+	i = 67;
+	RUN_TEST1(nn_kernels_match_scalar, (void*)&i);
 }
 
 SUITE(nn_time)
@@ -579,6 +2372,29 @@ SUITE(neat)
 {
 	RUN_TEST(neat_create_and_destroy);
 	RUN_TEST(neat_xor);
+	RUN_TEST(neat_seed_reproducible);
+	RUN_TEST(neat_tick_matches_time_alive);
+	RUN_TEST(neat_tick_passes_birth_queue);
+	RUN_TEST(neat_shared_genomes_stay_separate);
+	RUN_TEST(neat_save_load_continues);
+	RUN_TEST(neat_load_checks_dead_species);
+	RUN_TEST(neat_load_checks_genome_shape);
+	RUN_TEST(neat_snapshot_matches_population);
+	RUN_TEST(neat_snapshot_map_file);
+	RUN_TEST(neat_generation_threads);
+	RUN_TEST(neat_generation_replaces_weakest);
+	RUN_TEST(neat_respeciation_threads);
+	RUN_TEST(neat_evaluate_parallel_matches_serial);
+	RUN_TEST(neat_genome_info_counts);
+	RUN_TEST(neat_fingerprint_memo);
+	RUN_TEST(neat_encode_decode);
+	RUN_TEST(neat_species_membership);
+	RUN_TEST(neat_species_fitness_sum);
+	RUN_TEST(neat_species_selection_frequencies);
+	RUN_TEST(neat_species_handles);
+	RUN_TEST(neat_species_second_genitor);
+	RUN_TEST(neat_worst_genome_matches_scan);
+	RUN_TEST(neat_genome_reproduce_in_place);
 }
 
 GREATEST_MAIN_DEFS();